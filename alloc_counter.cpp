@@ -0,0 +1,49 @@
+#include "alloc_counter.h"
+
+#ifdef COUNT_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local long long allocations = 0;
+
+void* countedAllocate(std::size_t size) {
+    allocations++;
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+} // namespace
+
+// nothrow 版本在 libstdc++ 中转调这里；对齐版本 (aligned new) 不经过这里，本程序未使用
+void* operator new(std::size_t size) { return countedAllocate(size); }
+void* operator new[](std::size_t size) { return countedAllocate(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+
+bool AllocationCounter::enabled() {
+    return true;
+}
+
+long long AllocationCounter::threadCount() {
+    return allocations;
+}
+
+#else
+
+bool AllocationCounter::enabled() {
+    return false;
+}
+
+long long AllocationCounter::threadCount() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+// 堆分配计数: 用 -DCOUNT_ALLOCATIONS 编译时替换全局 operator new，按线程累计分配次数，
+// 用来验证分块发送的热路径在预热后不再分配内存 (make alloc-check)。
+// 普通构建中不替换 operator new，threadCount() 恒为 0。
+class AllocationCounter {
+public:
+    static bool enabled();
+    // 当前线程累计的 operator new 次数
+    static long long threadCount();
+};
+
+#endif
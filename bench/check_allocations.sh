@@ -0,0 +1,81 @@
+#!/bin/bash
+# 热路径堆分配检查: 用替换了 operator new 的客户端 (make alloc-check 构建) 在回环上分块发送，
+# 每个发送线程的第一块作为预热，之后每块的堆分配次数 (发送线程 + 预读线程) 必须为 0。
+# 分别检查缓冲 (pread+send) 和 sendfile 两种发送引擎。v1 服务器最多分 16 块 (块大小相应放大)，
+# 4 个线程时预热后计数 12 块。
+#
+# 环境变量:
+#   ALLOC_FILE_MB   测试文件大小 MB (默认 64)
+#   ALLOC_THREADS   发送线程数 (默认 4)
+#   ALLOC_PORT      服务器端口 (默认 19300)
+#   ALLOC_WORK      测试数据和服务器目录 (默认 bench/work/alloc)
+
+set -u
+
+cd "$(dirname "$0")/.." || exit 1
+ROOT=$(pwd)
+CLIENT=$ROOT/bench/file_transfer_client_alloc
+SERVER=$ROOT/file_transfer_server
+GEN=$ROOT/bench/gen_workload
+
+FILE_MB=${ALLOC_FILE_MB:-64}
+THREADS=${ALLOC_THREADS:-4}
+PORT=${ALLOC_PORT:-19300}
+WORK=${ALLOC_WORK:-$ROOT/bench/work/alloc}
+
+for binary in "$CLIENT" "$SERVER" "$GEN"; do
+    if [[ ! -x $binary ]]; then
+        echo "找不到 $binary，请先运行 make alloc-check" >&2
+        exit 1
+    fi
+done
+
+port_in_use() {
+    (exec 3<>/dev/tcp/127.0.0.1/"$1") 2>/dev/null
+}
+
+if port_in_use "$PORT"; then
+    echo "端口 $PORT 已被占用，请先停止占用它的进程或用 ALLOC_PORT 指定其他端口" >&2
+    exit 1
+fi
+
+mkdir -p "$WORK/server" "$WORK/client"
+SOURCE=$WORK/file_${FILE_MB}m.bin
+if [[ ! -f $SOURCE ]]; then
+    "$GEN" file "$SOURCE.tmp" "$FILE_MB" 20240601 && mv "$SOURCE.tmp" "$SOURCE" || exit 1
+fi
+
+(cd "$WORK/server" && exec "$SERVER" "$PORT" >"$WORK/server.log" 2>&1) &
+SERVER_PID=$!
+trap 'kill $SERVER_PID 2>/dev/null' EXIT
+for _ in $(seq 50); do
+    port_in_use "$PORT" && break
+    sleep 0.1
+done
+
+failed=0
+for engine in buffered sendfile; do
+    rm -rf "$WORK/server/"* "$WORK/client/"*
+    log=$WORK/client_$engine.log
+    (cd "$WORK/client" && "$CLIENT" --server "127.0.0.1:$PORT" --mode mt --threads "$THREADS" --chunk-mb 1 \
+        --engine "$engine" --restart "$SOURCE" >"$log" 2>&1 </dev/null)
+
+    # 输出形如 " 热路径堆分配: 预热后 12 块共 0 次"
+    line=$(grep '热路径堆分配' "$log")
+    chunks=$(echo "$line" | sed -n 's/.*预热后 \([0-9]*\) 块.*/\1/p')
+    allocations=$(echo "$line" | sed -n 's/.*共 \([0-9]*\) 次.*/\1/p')
+    if [[ -z $chunks || -z $allocations ]]; then
+        echo "$engine: 没有找到堆分配统计 (块数须多于线程数)，见 $log" >&2
+        failed=1
+    elif ! cmp -s "$SOURCE" "$WORK/server/$(basename "$SOURCE")"; then
+        echo "$engine: 服务器上的文件与源文件不一致，见 $log" >&2
+        failed=1
+    elif [[ $allocations != 0 ]]; then
+        echo "$engine: 预热后 $chunks 块共 $allocations 次堆分配，应为 0" >&2
+        failed=1
+    else
+        echo "$engine: 预热后 $chunks 块，堆分配 0 次"
+    fi
+done
+
+exit $failed
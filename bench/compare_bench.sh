@@ -0,0 +1,52 @@
+#!/bin/bash
+# 比较两次 run_bench.sh 的结果: 每个负载取各次运行的中位数，列出吞吐和 CPU 的变化。
+# 用法: compare_bench.sh <旧结果.csv> <新结果.csv> [阈值百分比，默认 5]
+# 吞吐下降或 CPU 上升超过阈值的负载标记为 REGRESSION，存在时退出码为 1。
+
+if [[ $# -lt 2 ]]; then
+    echo "用法: $0 <旧结果.csv> <新结果.csv> [阈值百分比]" >&2
+    exit 2
+fi
+
+awk -F, -v threshold="${3:-5}" '
+function median(key,    n, i, j, tmp, values) {
+    n = count[key]
+    for (i = 1; i <= n; i++) values[i] = samples[key, i]
+    for (i = 2; i <= n; i++) {
+        tmp = values[i]
+        for (j = i - 1; j > 0 && values[j] > tmp; j--) values[j + 1] = values[j]
+        values[j + 1] = tmp
+    }
+    return n % 2 ? values[(n + 1) / 2] : (values[n / 2] + values[n / 2 + 1]) / 2
+}
+function add(key, value) {
+    samples[key, ++count[key]] = value
+}
+FNR == 1 { file++; next }
+$15 != "ok" { failed[file, $2] = 1; next }
+{
+    if (!($2 in seen)) { seen[$2] = 1; order[++workloads] = $2 }
+    add(file SUBSEP $2 SUBSEP "tput", $8)
+    add(file SUBSEP $2 SUBSEP "cpu", $9 + $10)
+}
+END {
+    printf "%-12s %12s %12s %8s %12s %12s %8s\n", "负载", "旧 MiB/s", "新 MiB/s", "变化", "旧 CPU s/GiB", "新 CPU s/GiB", "变化"
+    regressions = 0
+    for (w = 1; w <= workloads; w++) {
+        name = order[w]
+        if (!count[1 SUBSEP name SUBSEP "tput"] || !count[2 SUBSEP name SUBSEP "tput"]) {
+            printf "%-12s %s\n", name, "缺少成功的运行结果"
+            continue
+        }
+        oldTput = median(1 SUBSEP name SUBSEP "tput"); newTput = median(2 SUBSEP name SUBSEP "tput")
+        oldCpu = median(1 SUBSEP name SUBSEP "cpu"); newCpu = median(2 SUBSEP name SUBSEP "cpu")
+        tputChange = oldTput > 0 ? (newTput - oldTput) / oldTput * 100 : 0
+        cpuChange = oldCpu > 0 ? (newCpu - oldCpu) / oldCpu * 100 : 0
+        flag = ""
+        if (tputChange < -threshold || cpuChange > threshold) { flag = "  REGRESSION"; regressions++ }
+        if (failed[2, name]) flag = flag "  (新结果中有失败的运行)"
+        printf "%-12s %12.1f %12.1f %+7.1f%% %12.3f %12.3f %+7.1f%%%s\n",
+               name, oldTput, newTput, tputChange, oldCpu, newCpu, cpuChange, flag
+    }
+    exit regressions > 0
+}' "$1" "$2"
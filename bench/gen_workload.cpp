@@ -0,0 +1,117 @@
+// 基准测试数据生成器: 同样的参数和种子总是生成逐字节相同的文件和目录树，
+// 不同提交之间的测试结果才可以直接比较。数据是伪随机的，不可压缩。
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+const size_t WRITE_BLOCK = 1024 * 1024;
+const int FILES_PER_DIRECTORY = 100;
+
+// xorshift64*: 足够快，结果只取决于种子
+class Random {
+public:
+    explicit Random(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    uint64_t state;
+};
+
+void makeDirectory(const std::string& path) {
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "无法创建目录: " << path << std::endl;
+        exit(1);
+    }
+}
+
+void writeFile(const std::string& path, long long size, uint64_t seed) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "无法创建文件: " << path << std::endl;
+        exit(1);
+    }
+
+    Random random(seed);
+    std::vector<uint64_t> block(WRITE_BLOCK / sizeof(uint64_t));
+    long long written = 0;
+    while (written < size) {
+        for (auto& word : block) {
+            word = random.next();
+        }
+        size_t length = static_cast<size_t>(std::min<long long>(WRITE_BLOCK, size - written));
+        if (write(fd, block.data(), length) != static_cast<ssize_t>(length)) {
+            std::cerr << "写入失败: " << path << std::endl;
+            exit(1);
+        }
+        written += length;
+    }
+    close(fd);
+}
+
+// 文件分散到子目录中，每个子目录最多 FILES_PER_DIRECTORY 个
+std::string filePath(const std::string& root, int index) {
+    std::string directory = root + "/d" + std::to_string(index / FILES_PER_DIRECTORY);
+    if (index % FILES_PER_DIRECTORY == 0) {
+        makeDirectory(directory);
+    }
+    return directory + "/f" + std::to_string(index);
+}
+
+void usage(const char* program) {
+    std::cerr << "用法:\n"
+              << "  " << program << " file <路径> <大小MB> <种子>          单个文件\n"
+              << "  " << program << " small <目录> <个数> <大小KB> <种子>  大量同样大小的小文件\n"
+              << "  " << program << " mixed <目录> <个数> <种子>           1KB~16MB 对数均匀分布的混合大小文件\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string kind = argc > 1 ? argv[1] : "";
+
+    if (kind == "file" && argc == 5) {
+        writeFile(argv[2], std::atoll(argv[3]) * 1024 * 1024, std::strtoull(argv[4], nullptr, 10));
+    } else if (kind == "small" && argc == 6) {
+        std::string root = argv[2];
+        int count = std::atoi(argv[3]);
+        long long size = std::atoll(argv[4]) * 1024;
+        uint64_t seed = std::strtoull(argv[5], nullptr, 10);
+        makeDirectory(root);
+        for (int i = 0; i < count; i++) {
+            writeFile(filePath(root, i), size, seed + i);
+        }
+    } else if (kind == "mixed" && argc == 5) {
+        std::string root = argv[2];
+        int count = std::atoi(argv[3]);
+        uint64_t seed = std::strtoull(argv[4], nullptr, 10);
+        makeDirectory(root);
+        Random sizes(seed);
+        for (int i = 0; i < count; i++) {
+            double exponent = std::log(1024.0) + sizes.uniform() * (std::log(16.0 * 1024 * 1024) - std::log(1024.0));
+            writeFile(filePath(root, i), static_cast<long long>(std::exp(exponent)), seed + i + 1);
+        }
+    } else {
+        usage(argv[0]);
+        return 2;
+    }
+    return 0;
+}
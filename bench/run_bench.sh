@@ -0,0 +1,223 @@
+#!/bin/bash
+# 回环基准测试: 在 127.0.0.1 上启动服务器，依次运行固定的传输负载，
+# 每次运行追加一行 CSV 到 bench/results/<时间>-<提交>.csv，用 compare_bench.sh 比较两次结果。
+#
+# 环境变量:
+#   BENCH_FILE_MB      单文件负载大小 MB (默认 1024)
+#   BENCH_SMALL_COUNT  小文件负载的文件个数，每个 4KB (默认 10000)
+#   BENCH_MIXED_COUNT  混合大小负载的文件个数，1KB~16MB (默认 200)
+#   BENCH_REPEAT       每个负载重复次数 (默认 3)
+#   BENCH_FILTER       只运行名称匹配该正则的负载，例如 '^mt_'
+#   BENCH_PORT         服务器端口 (默认 19100)
+#   BENCH_WORK         测试数据和服务器目录 (默认 bench/work，数据生成后复用)
+#   BENCH_WAN          非空时客户端经 tools/wan_proxy 连接服务器 (端口 BENCH_PORT+1)，
+#                      取值为代理参数，例如 '--delay 20 --jitter 2 --rate 200 --window 4096'
+#
+# 系统调用数取自 /proc/<pid>/io 的 syscr + syscw，只统计 read/write 类调用
+# (read、pread、recv、write、send、sendfile 等)，不需要 strace 或 perf。
+
+set -u
+
+cd "$(dirname "$0")/.." || exit 1
+ROOT=$(pwd)
+CLIENT=$ROOT/file_transfer_client
+SERVER=$ROOT/file_transfer_server
+GEN=$ROOT/bench/gen_workload
+PROXY=$ROOT/tools/wan_proxy
+
+FILE_MB=${BENCH_FILE_MB:-1024}
+SMALL_COUNT=${BENCH_SMALL_COUNT:-10000}
+MIXED_COUNT=${BENCH_MIXED_COUNT:-200}
+REPEAT=${BENCH_REPEAT:-3}
+FILTER=${BENCH_FILTER:-.}
+PORT=${BENCH_PORT:-19100}
+WORK=${BENCH_WORK:-$ROOT/bench/work}
+WAN=${BENCH_WAN:-}
+SEED=20240601
+
+BINARIES=("$CLIENT" "$SERVER" "$GEN")
+[[ -n $WAN ]] && BINARIES+=("$PROXY")
+for binary in "${BINARIES[@]}"; do
+    if [[ ! -x $binary ]]; then
+        echo "找不到 $binary，请先运行 make bench" >&2
+        exit 1
+    fi
+done
+
+port_in_use() {
+    (exec 3<>/dev/tcp/127.0.0.1/"$1") 2>/dev/null
+}
+
+wait_for_port() {
+    for _ in $(seq 50); do
+        port_in_use "$1" && return
+        sleep 0.1
+    done
+}
+
+# 端口被占用时直接退出，不结束占用的进程，那可能是与测试无关的服务
+for port in "$PORT" ${WAN:+$((PORT + 1))}; do
+    if port_in_use "$port"; then
+        echo "端口 $port 已被占用，请先停止占用它的进程或用 BENCH_PORT 指定其他端口" >&2
+        exit 1
+    fi
+done
+
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+if [[ $COMMIT != unknown ]] && ! git diff --quiet HEAD 2>/dev/null; then
+    COMMIT=$COMMIT-dirty
+fi
+mkdir -p "$ROOT/bench/results"
+RESULTS=${1:-$ROOT/bench/results/$(date +%Y%m%d-%H%M%S)-$COMMIT.csv}
+
+# ---- 测试数据 (目录名包含参数，参数不变时直接复用) ----
+DATA=$WORK/data
+mkdir -p "$DATA" "$WORK/server" "$WORK/client"
+
+BIG=$DATA/file_${FILE_MB}m.bin
+SMALL=$DATA/small_${SMALL_COUNT}x4k
+MIXED=$DATA/mixed_${MIXED_COUNT}
+HUGE=$DATA/huge_${FILE_MB}m
+
+if [[ ! -f $BIG ]]; then
+    echo "生成 $BIG"
+    "$GEN" file "$BIG.tmp" "$FILE_MB" "$SEED" && mv "$BIG.tmp" "$BIG" || exit 1
+fi
+if [[ ! -d $SMALL ]]; then
+    echo "生成 $SMALL"
+    "$GEN" small "$SMALL.tmp" "$SMALL_COUNT" 4 "$SEED" && mv "$SMALL.tmp" "$SMALL" || exit 1
+fi
+if [[ ! -d $MIXED ]]; then
+    echo "生成 $MIXED"
+    "$GEN" mixed "$MIXED.tmp" "$MIXED_COUNT" "$SEED" && mv "$MIXED.tmp" "$MIXED" || exit 1
+fi
+if [[ ! -d $HUGE ]]; then
+    # 单个大文件的目录与单文件负载共用数据
+    mkdir -p "$HUGE" && ln "$BIG" "$HUGE/huge.bin" 2>/dev/null || cp "$BIG" "$HUGE/huge.bin"
+fi
+
+# 名称|模式|线程数|源路径
+WORKLOADS=(
+    "seq|seq|1|$BIG"
+    "mt_t1|mt|1|$BIG"
+    "mt_t2|mt|2|$BIG"
+    "mt_t4|mt|4|$BIG"
+    "mt_t8|mt|8|$BIG"
+    "mt_t16|mt|16|$BIG"
+    "mt_auto|mt|auto|$BIG"
+    "dir_small|dir|4|$SMALL"
+    "dir_mixed|dir|4|$MIXED"
+    "dir_huge|dir|4|$HUGE"
+)
+
+# ---- 服务器 ----
+CLK_TCK=$(getconf CLK_TCK)
+(cd "$WORK/server" && exec "$SERVER" "$PORT" >"$WORK/server.log" 2>&1) &
+SERVER_PID=$!
+PROXY_PID=
+trap 'kill $SERVER_PID $PROXY_PID 2>/dev/null' EXIT
+
+wait_for_port "$PORT"
+if ! kill -0 "$SERVER_PID" 2>/dev/null; then
+    echo "服务器启动失败，见 $WORK/server.log" >&2
+    exit 1
+fi
+
+# ---- 广域网模拟代理 (可选) ----
+CLIENT_PORT=$PORT
+NETWORK=loopback
+if [[ -n $WAN ]]; then
+    CLIENT_PORT=$((PORT + 1))
+    # shellcheck disable=SC2086
+    "$PROXY" --listen "$CLIENT_PORT" --target "127.0.0.1:$PORT" $WAN >"$WORK/proxy.log" 2>&1 &
+    PROXY_PID=$!
+    wait_for_port "$CLIENT_PORT"
+    if ! kill -0 "$PROXY_PID" 2>/dev/null; then
+        echo "代理启动失败，见 $WORK/proxy.log" >&2
+        exit 1
+    fi
+    # 代理参数去掉 "--" 和空格后作为网络条件记录，例如 delay=20;rate=200
+    NETWORK=$(echo "$WAN" | awk '{for (i = 1; i < NF; i += 2) printf "%s%s=%s", (i > 1 ? ";" : ""), substr($i, 3), $(i + 1)}')
+fi
+
+server_cpu_ticks() {
+    awk '{print $14 + $15}' "/proc/$SERVER_PID/stat"
+}
+
+server_syscalls() {
+    awk '/^sysc[rw]:/ {sum += $2} END {print sum + 0}' "/proc/$SERVER_PID/io" 2>/dev/null || echo 0
+}
+
+server_peak_rss() {
+    awk '/^VmHWM:/ {print $2}' "/proc/$SERVER_PID/status"
+}
+
+json_field() {
+    sed -n "s/.*\"$2\":\"\{0,1\}\([^,\"}]*\).*/\1/p" "$1"
+}
+
+total_bytes() {
+    if [[ -d $1 ]]; then
+        find "$1" -type f -printf '%s\n' | awk '{sum += $1} END {print sum + 0}'
+    else
+        stat -c %s "$1"
+    fi
+}
+
+echo "commit,workload,mode,threads,run,bytes,wall_s,mib_per_s,client_cpu_s_per_gib,server_cpu_s_per_gib,client_syscalls_per_gib,server_syscalls_per_gib,client_peak_rss_kb,server_peak_rss_kb,status,network" >"$RESULTS"
+
+for workload in "${WORKLOADS[@]}"; do
+    IFS='|' read -r name mode threads source <<<"$workload"
+    [[ $name =~ $FILTER ]] || continue
+    bytes=$(total_bytes "$source")
+
+    for run in $(seq "$REPEAT"); do
+        rm -rf "$WORK/server/"* "$WORK/client/"*
+        report=$WORK/client/report.json
+        # 重置服务器的峰值内存统计 (VmHWM)，旧内核不支持时记录的是启动以来的峰值
+        echo 5 >"/proc/$SERVER_PID/clear_refs" 2>/dev/null
+        ticksBefore=$(server_cpu_ticks)
+        syscallsBefore=$(server_syscalls)
+
+        # 每次都从头传输: 上一次中断留下的断点会被重置，而不是接着续传
+        (cd "$WORK/client" && "$CLIENT" --server "127.0.0.1:$CLIENT_PORT" --mode "$mode" --threads "$threads" \
+            --restart --report "$report" "$source" >"$WORK/client.log" 2>&1 </dev/null)
+
+        ticksAfter=$(server_cpu_ticks)
+        syscallsAfter=$(server_syscalls)
+        serverRss=$(server_peak_rss)
+
+        status=$(json_field "$report" status)
+        target=$WORK/server/$(basename "$source")
+        if [[ $status == ok ]]; then
+            if [[ -d $source ]]; then
+                diff -r "$source" "$target" >/dev/null 2>&1 || status=mismatch
+            else
+                cmp -s "$source" "$target" || status=mismatch
+            fi
+        fi
+
+        row=$(awk -v commit="$COMMIT" -v name="$name" -v mode="$mode" -v threads="$threads" -v run="$run" \
+            -v bytes="$bytes" -v wall="$(json_field "$report" wall_ms)" \
+            -v user="$(json_field "$report" user_ms)" -v sys="$(json_field "$report" sys_ms)" \
+            -v syscr="$(json_field "$report" syscr)" -v syscw="$(json_field "$report" syscw)" \
+            -v rss="$(json_field "$report" max_rss_kb)" -v serverTicks=$((ticksAfter - ticksBefore)) \
+            -v serverSyscalls=$((syscallsAfter - syscallsBefore)) -v serverRss="$serverRss" \
+            -v tck="$CLK_TCK" -v status="${status:-failed}" -v network="$NETWORK" 'BEGIN {
+                gib = bytes / 1073741824
+                wall_s = wall / 1000
+                printf "%s,%s,%s,%s,%d,%d,%.3f,%.1f,%.3f,%.3f,%.0f,%.0f,%d,%d,%s,%s\n",
+                    commit, name, mode, threads, run, bytes, wall_s,
+                    (wall_s > 0 ? bytes / 1048576 / wall_s : 0),
+                    (gib > 0 ? (user + sys) / 1000 / gib : 0),
+                    (gib > 0 ? serverTicks / tck / gib : 0),
+                    (gib > 0 ? (syscr + syscw) / gib : 0),
+                    (gib > 0 ? serverSyscalls / gib : 0),
+                    rss, serverRss, status, network
+            }')
+        echo "$row" >>"$RESULTS"
+        echo "$row" | awk -F, '{printf "%-10s 第 %s 次  %8.1f MiB/s  %7.3f s  客户端 CPU %.3f s/GiB  %s\n", $2, $5, $8, $7, $9, $15}'
+    done
+done
+
+echo "结果已写入 $RESULTS"
@@ -0,0 +1,148 @@
+#include "buffer_pool.h"
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <unistd.h>
+
+const size_t BufferPool::SIZE_CLASSES[BufferPool::SIZE_CLASS_COUNT] = {
+    64 * 1024, 128 * 1024, 256 * 1024, 1024 * 1024, 4 * 1024 * 1024, 8 * 1024 * 1024
+};
+
+namespace {
+
+std::atomic<long long> acquireCount{0};
+std::atomic<long long> allocationCount{0};
+std::atomic<long long> threadCacheHitCount{0};
+std::atomic<long long> globalHitCount{0};
+
+struct GlobalPool {
+    std::mutex mutex;
+    std::vector<char*> free[BufferPool::SIZE_CLASS_COUNT];
+};
+
+// 有意不析构: 线程退出时的缓存归还可能晚于静态对象析构
+GlobalPool& globalPool() {
+    static GlobalPool* pool = new GlobalPool();
+    return *pool;
+}
+
+void returnToGlobal(char* buffer, int sizeClass) {
+    GlobalPool& pool = globalPool();
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (static_cast<int>(pool.free[sizeClass].size()) < BufferPool::GLOBAL_POOL_LIMIT) {
+            pool.free[sizeClass].push_back(buffer);
+            return;
+        }
+    }
+    std::free(buffer);
+}
+
+struct ThreadCache {
+    char* buffers[BufferPool::SIZE_CLASS_COUNT][BufferPool::THREAD_CACHE_LIMIT];
+    int count[BufferPool::SIZE_CLASS_COUNT] = {};
+
+    // 线程结束时把缓存交回全局池，供后续线程复用
+    ~ThreadCache() {
+        for (int c = 0; c < BufferPool::SIZE_CLASS_COUNT; c++) {
+            while (count[c] > 0) {
+                returnToGlobal(buffers[c][--count[c]], c);
+            }
+        }
+    }
+};
+
+thread_local ThreadCache threadCache;
+
+char* allocateAligned(size_t size) {
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, pageSize, size) != 0) {
+        throw std::bad_alloc();
+    }
+    allocationCount++;
+    return static_cast<char*>(buffer);
+}
+
+} // namespace
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+    : buffer(other.buffer), bufferCapacity(other.bufferCapacity), sizeClass(other.sizeClass) {
+    other.buffer = nullptr;
+    other.bufferCapacity = 0;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        buffer = other.buffer;
+        bufferCapacity = other.bufferCapacity;
+        sizeClass = other.sizeClass;
+        other.buffer = nullptr;
+        other.bufferCapacity = 0;
+    }
+    return *this;
+}
+
+PooledBuffer::~PooledBuffer() {
+    release();
+}
+
+void PooledBuffer::release() {
+    if (buffer != nullptr) {
+        BufferPool::release(buffer, sizeClass);
+        buffer = nullptr;
+        bufferCapacity = 0;
+    }
+}
+
+PooledBuffer BufferPool::acquire(size_t size) {
+    acquireCount++;
+
+    int sizeClass = 0;
+    while (sizeClass < SIZE_CLASS_COUNT && SIZE_CLASSES[sizeClass] < size) {
+        sizeClass++;
+    }
+    if (sizeClass == SIZE_CLASS_COUNT) {
+        return PooledBuffer(allocateAligned(size), size, -1);
+    }
+
+    ThreadCache& cache = threadCache;
+    if (cache.count[sizeClass] > 0) {
+        threadCacheHitCount++;
+        return PooledBuffer(cache.buffers[sizeClass][--cache.count[sizeClass]], SIZE_CLASSES[sizeClass], sizeClass);
+    }
+
+    GlobalPool& pool = globalPool();
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (!pool.free[sizeClass].empty()) {
+            char* buffer = pool.free[sizeClass].back();
+            pool.free[sizeClass].pop_back();
+            globalHitCount++;
+            return PooledBuffer(buffer, SIZE_CLASSES[sizeClass], sizeClass);
+        }
+    }
+
+    return PooledBuffer(allocateAligned(SIZE_CLASSES[sizeClass]), SIZE_CLASSES[sizeClass], sizeClass);
+}
+
+void BufferPool::release(char* buffer, int sizeClass) {
+    if (sizeClass < 0) {
+        std::free(buffer);
+        return;
+    }
+
+    ThreadCache& cache = threadCache;
+    if (cache.count[sizeClass] < THREAD_CACHE_LIMIT) {
+        cache.buffers[sizeClass][cache.count[sizeClass]++] = buffer;
+        return;
+    }
+    returnToGlobal(buffer, sizeClass);
+}
+
+BufferPool::Stats BufferPool::stats() {
+    return {acquireCount.load(), allocationCount.load(), threadCacheHitCount.load(), globalHitCount.load()};
+}
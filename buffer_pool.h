@@ -0,0 +1,58 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <cstddef>
+
+// 从 BufferPool 借出的缓冲区，析构时自动归还
+class PooledBuffer {
+public:
+    PooledBuffer() : buffer(nullptr), bufferCapacity(0), sizeClass(-1) {}
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    ~PooledBuffer();
+
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    char* data() const { return buffer; }
+    size_t capacity() const { return bufferCapacity; }
+
+private:
+    friend class BufferPool;
+    PooledBuffer(char* buffer, size_t capacity, int sizeClass)
+        : buffer(buffer), bufferCapacity(capacity), sizeClass(sizeClass) {}
+    void release();
+
+    char* buffer;
+    size_t bufferCapacity;
+    int sizeClass;   // -1 表示超出最大规格，归还时直接释放
+};
+
+// 按规格分级、页对齐的传输缓冲池。
+// 每个线程先从自己的缓存取，缓存空了再加锁访问全局池，都没有时才 posix_memalign。
+// 稳态下数据缓冲区不再重新分配，可以用 stats().allocations 验证；它只统计池内缓冲区。
+// 分块发送热路径上的其余对象 (消息、区间表、日志槽、预读线程) 按线程复用，
+// 整体的堆分配次数由 make alloc-check 检查 (见 alloc_counter.h)。
+class BufferPool {
+public:
+    static const int SIZE_CLASS_COUNT = 6;
+    static const size_t SIZE_CLASSES[SIZE_CLASS_COUNT];   // 64KB ~ 8MB
+    static const int THREAD_CACHE_LIMIT = 4;              // 每个线程每种规格最多缓存的个数
+    static const int GLOBAL_POOL_LIMIT = 64;
+
+    struct Stats {
+        long long acquires;
+        long long allocations;       // 实际调用 posix_memalign 的次数
+        long long threadCacheHits;
+        long long globalHits;
+    };
+
+    static PooledBuffer acquire(size_t size);
+    static Stats stats();
+
+private:
+    friend class PooledBuffer;
+    static void release(char* buffer, int sizeClass);
+};
+
+#endif
@@ -0,0 +1,416 @@
+#include "checksum.h"
+#include <cstring>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const uint32_t CRC32C_POLY = 0x82F63B78;  // 反射形式的 Castagnoli 多项式
+
+struct Crc32cTable {
+    uint32_t table[8][256];
+
+    Crc32cTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int slice = 1; slice < 8; slice++) {
+                table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+const Crc32cTable& crcTable() {
+    static const Crc32cTable instance;
+    return instance;
+}
+
+// slicing-by-8 软件实现
+uint32_t crc32cSoftware(uint32_t crc, const unsigned char* p, size_t length) {
+    const Crc32cTable& t = crcTable();
+    while (length >= 8) {
+        uint32_t low;
+        uint32_t high;
+        memcpy(&low, p, 4);
+        memcpy(&high, p + 4, 4);
+        low ^= crc;
+        crc = t.table[7][low & 0xff] ^ t.table[6][(low >> 8) & 0xff] ^
+              t.table[5][(low >> 16) & 0xff] ^ t.table[4][low >> 24] ^
+              t.table[3][high & 0xff] ^ t.table[2][(high >> 8) & 0xff] ^
+              t.table[1][(high >> 16) & 0xff] ^ t.table[0][high >> 24];
+        p += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        crc = (crc >> 8) ^ t.table[0][(crc ^ *p++) & 0xff];
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t crc32cHardware(uint32_t crc, const unsigned char* p, size_t length) {
+    uint64_t crc64 = crc;
+    while (length >= 8) {
+        uint64_t value;
+        memcpy(&value, p, 8);
+        crc64 = _mm_crc32_u64(crc64, value);
+        p += 8;
+        length -= 8;
+    }
+    crc = static_cast<uint32_t>(crc64);
+    while (length-- > 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+uint32_t gf2MatrixTimes(const uint32_t* matrix, uint32_t vector) {
+    uint32_t sum = 0;
+    while (vector) {
+        if (vector & 1) {
+            sum ^= *matrix;
+        }
+        vector >>= 1;
+        matrix++;
+    }
+    return sum;
+}
+
+void gf2MatrixSquare(uint32_t* square, const uint32_t* matrix) {
+    for (int n = 0; n < 32; n++) {
+        square[n] = gf2MatrixTimes(matrix, matrix[n]);
+    }
+}
+
+const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl64(uint64_t value, int shift) {
+    return (value << shift) | (value >> (64 - shift));
+}
+
+inline uint64_t read64(const unsigned char* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t read32(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+inline uint64_t mergeRound64(uint64_t acc, uint64_t value) {
+    acc ^= round64(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+const uint32_t SHA256_INITIAL[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+alignas(16) const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+inline uint32_t rotr32(uint32_t value, int shift) {
+    return (value >> shift) | (value << (32 - shift));
+}
+
+inline uint32_t readBigEndian32(const unsigned char* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+void sha256Software(uint32_t state[8], const unsigned char* p, size_t blocks) {
+    while (blocks-- > 0) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = readBigEndian32(p + 4 * i);
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) +
+                          SHA256_K[i] + w[i];
+            uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        p += 64;
+    }
+}
+
+#if defined(__x86_64__)
+// SHA 扩展每条 sha256rnds2 做两轮，状态按 ABEF/CDGH 两个寄存器排列
+__attribute__((target("sha,sse4.1")))
+void sha256Hardware(uint32_t state[8], const unsigned char* p, size_t blocks) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i dcba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0]));
+    __m128i hgfe = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4]));
+    __m128i cdab = _mm_shuffle_epi32(dcba, 0xB1);
+    __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1B);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+    while (blocks-- > 0) {
+        __m128i abefSaved = abef;
+        __m128i cdghSaved = cdgh;
+        __m128i message[4];
+        for (int i = 0; i < 4; i++) {
+            message[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i)), byteSwap);
+        }
+
+        // 每组 4 轮，同时由前 4 组消息推出第 group + 4 组
+        for (int group = 0; group < 16; group++) {
+            __m128i current = message[group & 3];
+            __m128i rounds = _mm_add_epi32(current, _mm_load_si128(reinterpret_cast<const __m128i*>(&SHA256_K[4 * group])));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, rounds);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(rounds, 0x0E));
+
+            if (group < 12) {
+                __m128i next = _mm_sha256msg1_epu32(current, message[(group + 1) & 3]);
+                next = _mm_add_epi32(next, _mm_alignr_epi8(message[(group + 3) & 3], message[(group + 2) & 3], 4));
+                message[group & 3] = _mm_sha256msg2_epu32(next, message[(group + 3) & 3]);
+            }
+        }
+
+        abef = _mm_add_epi32(abef, abefSaved);
+        cdgh = _mm_add_epi32(cdgh, cdghSaved);
+        p += 64;
+    }
+
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), _mm_alignr_epi8(dchg, feba, 8));
+}
+#endif
+
+}
+
+bool Checksum::hardwareCrc32c() {
+#if defined(__x86_64__)
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+uint32_t Checksum::crc32c(uint32_t crc, const void* data, size_t length) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+#if defined(__x86_64__)
+    if (hardwareCrc32c()) {
+        return ~crc32cHardware(crc, p, length);
+    }
+#endif
+    return ~crc32cSoftware(crc, p, length);
+}
+
+// 与 zlib crc32_combine 相同的 GF(2) 矩阵方法，复杂度 O(log lengthB)
+uint32_t Checksum::crc32cCombine(uint32_t crcA, uint32_t crcB, uint64_t lengthB) {
+    if (lengthB == 0) {
+        return crcA;
+    }
+
+    uint32_t even[32];
+    uint32_t odd[32];
+
+    odd[0] = CRC32C_POLY;
+    uint32_t row = 1;
+    for (int n = 1; n < 32; n++) {
+        odd[n] = row;
+        row <<= 1;
+    }
+    gf2MatrixSquare(even, odd);
+    gf2MatrixSquare(odd, even);
+
+    do {
+        gf2MatrixSquare(even, odd);
+        if (lengthB & 1) {
+            crcA = gf2MatrixTimes(even, crcA);
+        }
+        lengthB >>= 1;
+        if (lengthB == 0) {
+            break;
+        }
+
+        gf2MatrixSquare(odd, even);
+        if (lengthB & 1) {
+            crcA = gf2MatrixTimes(odd, crcA);
+        }
+        lengthB >>= 1;
+    } while (lengthB != 0);
+
+    return crcA ^ crcB;
+}
+
+uint64_t Checksum::xxh64(const void* data, size_t length, uint64_t seed) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + length;
+    uint64_t hash;
+
+    if (length >= 32) {
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        const unsigned char* limit = end - 32;
+        do {
+            v1 = round64(v1, read64(p));
+            v2 = round64(v2, read64(p + 8));
+            v3 = round64(v3, read64(p + 16));
+            v4 = round64(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = mergeRound64(hash, v1);
+        hash = mergeRound64(hash, v2);
+        hash = mergeRound64(hash, v3);
+        hash = mergeRound64(hash, v4);
+    } else {
+        hash = seed + PRIME64_5;
+    }
+
+    hash += length;
+
+    while (p + 8 <= end) {
+        hash ^= round64(0, read64(p));
+        hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        hash ^= static_cast<uint64_t>(read32(p)) * PRIME64_1;
+        hash = rotl64(hash, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        hash ^= (*p) * PRIME64_5;
+        hash = rotl64(hash, 11) * PRIME64_1;
+        p++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+Sha256::Sha256() : pendingLength(0), totalLength(0) {
+    memcpy(state, SHA256_INITIAL, sizeof(state));
+}
+
+bool Sha256::hardwareSupported() {
+#if defined(__x86_64__)
+    static const bool supported = __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void Sha256::compress(const unsigned char* blocks, size_t count) {
+#if defined(__x86_64__)
+    if (hardwareSupported()) {
+        sha256Hardware(state, blocks, count);
+        return;
+    }
+#endif
+    sha256Software(state, blocks, count);
+}
+
+void Sha256::update(const void* data, size_t length) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    totalLength += length;
+
+    if (pendingLength > 0) {
+        size_t take = std::min(length, sizeof(pending) - pendingLength);
+        memcpy(pending + pendingLength, p, take);
+        pendingLength += take;
+        p += take;
+        length -= take;
+        if (pendingLength < sizeof(pending)) {
+            return;
+        }
+        compress(pending, 1);
+        pendingLength = 0;
+    }
+
+    size_t blocks = length / 64;
+    if (blocks > 0) {
+        compress(p, blocks);
+        p += blocks * 64;
+        length -= blocks * 64;
+    }
+    memcpy(pending, p, length);
+    pendingLength = length;
+}
+
+void Sha256::finish(uint8_t digest[DIGEST_SIZE]) {
+    uint64_t bitLength = totalLength * 8;
+    pending[pendingLength++] = 0x80;
+    if (pendingLength > 56) {
+        memset(pending + pendingLength, 0, sizeof(pending) - pendingLength);
+        compress(pending, 1);
+        pendingLength = 0;
+    }
+    memset(pending + pendingLength, 0, 56 - pendingLength);
+    for (int i = 0; i < 8; i++) {
+        pending[56 + i] = static_cast<unsigned char>(bitLength >> (56 - 8 * i));
+    }
+    compress(pending, 1);
+
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = static_cast<uint8_t>(state[i] >> 24);
+        digest[4 * i + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[4 * i + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[4 * i + 3] = static_cast<uint8_t>(state[i]);
+    }
+}
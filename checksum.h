@@ -0,0 +1,39 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstdint>
+#include <cstddef>
+
+class Checksum {
+public:
+    // CRC32C (Castagnoli)，x86 上运行时检测 SSE4.2 并使用 crc32 指令，否则查表
+    static uint32_t crc32c(uint32_t crc, const void* data, size_t length);
+    // 由 crc(A)、crc(B) 和 B 的长度得到 crc(A+B)，用于合并并行计算的块校验
+    static uint32_t crc32cCombine(uint32_t crcA, uint32_t crcB, uint64_t lengthB);
+    static bool hardwareCrc32c();
+
+    // xxHash64，用作增量同步的强块校验
+    static uint64_t xxh64(const void* data, size_t length, uint64_t seed = 0);
+};
+
+// SHA-256，用作块去重索引的键。x86 上运行时检测 SHA 指令扩展，否则用软件实现
+class Sha256 {
+public:
+    static constexpr size_t DIGEST_SIZE = 32;
+
+    Sha256();
+    void update(const void* data, size_t length);
+    void finish(uint8_t digest[DIGEST_SIZE]);
+
+    static bool hardwareSupported();
+
+private:
+    void compress(const unsigned char* blocks, size_t count);
+
+    uint32_t state[8];
+    unsigned char pending[64];
+    size_t pendingLength;
+    uint64_t totalLength;
+};
+
+#endif
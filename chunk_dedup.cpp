@@ -0,0 +1,72 @@
+#include "chunk_dedup.h"
+#include "wire_protocol.h"
+#include "buffer_pool.h"
+#include "../common/constants.h"
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+
+// 每项: 块号(4) + 摘要(32)
+const size_t DEDUP_ENTRY_SIZE = 4 + Sha256::DIGEST_SIZE;
+const size_t DEDUP_ENTRIES_PER_FRAME = (MAX_FRAME_PAYLOAD - 8) / DEDUP_ENTRY_SIZE;
+
+ChunkDigest ChunkDedup::digest(const char* data, size_t length) {
+    ChunkDigest result;
+    Sha256 hash;
+    hash.update(data, length);
+    hash.finish(result.bytes);
+    return result;
+}
+
+// 不用 mmap: 映射后文件被截断，访问越过文件末尾的页会收到 SIGBUS
+bool ChunkDedup::digestFileRange(int fd, long long offset, long long length, ChunkDigest& result) {
+    Sha256 hash;
+    PooledBuffer buffer = BufferPool::acquire(BUFFER_SIZE);
+    long long done = 0;
+    while (done < length) {
+        size_t toRead = std::min(static_cast<long long>(buffer.capacity()), length - done);
+        ssize_t bytesRead = pread(fd, buffer.data(), toRead, offset + done);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            return false;
+        }
+        hash.update(buffer.data(), bytesRead);
+        done += bytesRead;
+    }
+    hash.finish(result.bytes);
+    return true;
+}
+
+bool ChunkDedup::query(int socket, uint32_t sessionId, const std::vector<std::pair<int, ChunkDigest>>& chunks,
+                       std::vector<int>& materialized) {
+    materialized.clear();
+
+    for (size_t first = 0; first < chunks.size(); first += DEDUP_ENTRIES_PER_FRAME) {
+        size_t count = std::min(DEDUP_ENTRIES_PER_FRAME, chunks.size() - first);
+
+        WireMessage request(FrameType::DedupQuery);
+        request.put(sessionId);
+        request.put(static_cast<uint32_t>(count));
+        for (size_t i = first; i < first + count; i++) {
+            request.put(static_cast<uint32_t>(chunks[i].first));
+            request.putBytes(chunks[i].second.bytes, sizeof(chunks[i].second.bytes));
+        }
+
+        std::vector<char> payload;
+        if (!request.sendAll(socket) || !WireReader::recvFrame(socket, FrameType::DedupResult, payload)) {
+            return false;
+        }
+
+        WireReader reader(payload);
+        uint32_t hits = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < hits && reader.ok(); i++) {
+            materialized.push_back(static_cast<int>(reader.get<uint32_t>()));
+        }
+        if (!reader.ok()) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,29 @@
+#ifndef CHUNK_DEDUP_H
+#define CHUNK_DEDUP_H
+
+#include "checksum.h"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+// 块内容摘要 (SHA-256)，作为服务器去重索引的键。
+// 命中的块不经过网络也不参与整文件 CRC，内容只由摘要担保，所以必须抗碰撞
+struct ChunkDigest {
+    uint8_t bytes[Sha256::DIGEST_SIZE] = {};
+};
+
+// 内容寻址的块去重。上传前把各块摘要发给服务器，服务器从已有内容中
+// 就地生成 (reflink 或复制) 命中的块并记入会话，这些块不再经过网络。
+class ChunkDedup {
+public:
+    static ChunkDigest digest(const char* data, size_t length);
+    // 用 pread 分段读取，文件在此期间被截断时返回 false
+    static bool digestFileRange(int fd, long long offset, long long length, ChunkDigest& result);
+
+    // 查询 sessionId 会话中的块；materialized 返回服务器已生成的块号
+    static bool query(int socket, uint32_t sessionId, const std::vector<std::pair<int, ChunkDigest>>& chunks,
+                      std::vector<int>& materialized);
+};
+
+#endif
@@ -0,0 +1,279 @@
+#include "command_line.h"
+#include "network_utils.h"
+#include "../common/constants.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
+#include <sys/resource.h>
+
+namespace {
+
+std::string requireValue(int argc, char* argv[], int& i) {
+    if (i + 1 >= argc) {
+        throw std::runtime_error(std::string("参数缺少取值: ") + argv[i]);
+    }
+    return argv[++i];
+}
+
+int parseInt(const std::string& value, const std::string& name) {
+    try {
+        size_t used = 0;
+        int result = std::stoi(value, &used);
+        if (used == value.size()) {
+            return result;
+        }
+    } catch (...) {
+    }
+    throw std::runtime_error("无效的 " + name + ": " + value);
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c));
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// /proc/self/io 中的 syscr/syscw: read 类和 write 类系统调用次数 (含 recv、send、sendfile、pread 等)
+void readIoSyscalls(long long& reads, long long& writes) {
+    reads = writes = -1;
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    long long value;
+    while (io >> key >> value) {
+        if (key == "syscr:") {
+            reads = value;
+        } else if (key == "syscw:") {
+            writes = value;
+        }
+    }
+}
+
+void writeReport(const CommandLineOptions& options, bool ok, double wallMs) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    long long syscallReads, syscallWrites;
+    readIoSyscalls(syscallReads, syscallWrites);
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(3)
+         << "{\"mode\":\"" << options.mode << "\""
+         << ",\"path\":\"" << jsonEscape(options.path) << "\""
+         << ",\"threads\":" << (options.transfer.autoTuneStreams ? 0 : options.threads)
+         << ",\"chunk_size\":" << options.transfer.chunkSize
+         << ",\"status\":\"" << (ok ? "ok" : "failed") << "\""
+         << ",\"wall_ms\":" << wallMs
+         << ",\"user_ms\":" << usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0
+         << ",\"sys_ms\":" << usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0
+         << ",\"max_rss_kb\":" << usage.ru_maxrss
+         << ",\"syscr\":" << syscallReads
+         << ",\"syscw\":" << syscallWrites
+         << "}";
+
+    std::ofstream report(options.reportPath, std::ios::app);
+    if (!report) {
+        std::cerr << " 无法写入结果文件: " << options.reportPath << std::endl;
+        return;
+    }
+    report << line.str() << std::endl;
+}
+
+} // namespace
+
+bool CommandLine::parse(int argc, char* argv[], CommandLineOptions& options) {
+    if (argc <= 1) {
+        return false;
+    }
+
+    bool engineGiven = false;
+    options.transfer.resumePolicy = ResumePolicy::Refuse;   // 命令行模式不读标准输入
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            options.mode = "help";
+            return true;
+        } else if (arg == "--server") {
+            std::string value = requireValue(argc, argv, i);
+            size_t colon = value.rfind(':');
+            if (colon == std::string::npos) {
+                throw std::runtime_error("服务器地址格式应为 IP:端口: " + value);
+            }
+            options.serverIP = value.substr(0, colon);
+            options.serverPort = parseInt(value.substr(colon + 1), "端口");
+        } else if (arg == "--mode") {
+            options.mode = requireValue(argc, argv, i);
+        } else if (arg == "--threads") {
+            std::string value = requireValue(argc, argv, i);
+            if (value == "auto") {
+                options.transfer.autoTuneStreams = true;
+                options.threads = MAX_THREADS;
+            } else {
+                options.threads = std::max(1, std::min(parseInt(value, "线程数"), MAX_THREADS));
+            }
+        } else if (arg == "--chunk-mb") {
+            int sizeMB = std::max(1, std::min(parseInt(requireValue(argc, argv, i), "块大小"), 64));
+            options.transfer.chunkSize = static_cast<long long>(sizeMB) * 1024 * 1024;
+        } else if (arg == "--engine") {
+            std::string value = requireValue(argc, argv, i);
+            if (value != "buffered" && value != "sendfile") {
+                throw std::runtime_error("未知的发送引擎: " + value);
+            }
+            options.transfer.sendEngine = (value == "buffered") ? SendEngine::Buffered : SendEngine::ZeroCopy;
+            engineGiven = true;
+        } else if (arg == "--compress") {
+            std::string value = requireValue(argc, argv, i);
+            if (value == "none") {
+                options.transfer.compression = CompressionMode::None;
+            } else if (value == "fast") {
+                options.transfer.compression = CompressionMode::Fast;
+            } else if (value == "high") {
+                options.transfer.compression = CompressionMode::High;
+            } else {
+                throw std::runtime_error("未知的压缩方式: " + value);
+            }
+        } else if (arg == "--sync") {
+            std::string value = requireValue(argc, argv, i);
+            if (value == "full") {
+                options.transfer.syncMode = SyncMode::Full;
+            } else if (value == "incremental") {
+                options.transfer.syncMode = SyncMode::Incremental;
+            } else if (value == "mirror") {
+                options.transfer.syncMode = SyncMode::Mirror;
+            } else {
+                throw std::runtime_error("未知的同步方式: " + value);
+            }
+        } else if (arg == "--resume") {
+            options.transfer.resumePolicy = ResumePolicy::Resume;
+        } else if (arg == "--restart") {
+            options.transfer.resumePolicy = ResumePolicy::Restart;
+        } else if (arg == "--dest") {
+            options.localDir = requireValue(argc, argv, i);
+        } else if (arg == "--report") {
+            options.reportPath = requireValue(argc, argv, i);
+        } else if (arg == "--metrics") {
+            options.transfer.metricsPath = requireValue(argc, argv, i);
+        } else if (arg == "--metrics-interval") {
+            options.transfer.metricsIntervalMs = std::max(100, parseInt(requireValue(argc, argv, i), "指标间隔"));
+        } else if (arg == "--trace") {
+            options.transfer.tracePath = requireValue(argc, argv, i);
+        } else if (arg == "--log-level") {
+            std::string value = requireValue(argc, argv, i);
+            if (value == "debug") {
+                options.logLevel = LogLevel::Debug;
+            } else if (value == "info") {
+                options.logLevel = LogLevel::Info;
+            } else if (value == "warn") {
+                options.logLevel = LogLevel::Warn;
+            } else if (value == "error") {
+                options.logLevel = LogLevel::Error;
+            } else {
+                throw std::runtime_error("未知的日志级别: " + value);
+            }
+        } else if (!arg.empty() && arg[0] == '-') {
+            throw std::runtime_error("未知参数: " + arg);
+        } else if (options.path.empty()) {
+            options.path = arg;
+        } else {
+            throw std::runtime_error("多余的参数: " + arg);
+        }
+    }
+
+    static const char* const modes[] = {"seq", "mt", "dir", "delta", "get", "getdir"};
+    if (std::find(std::begin(modes), std::end(modes), options.mode) == std::end(modes)) {
+        throw std::runtime_error(options.mode.empty() ? "缺少 --mode" : "未知的传输模式: " + options.mode);
+    }
+    if (options.path.empty()) {
+        throw std::runtime_error("缺少传输路径");
+    }
+
+    // 与交互模式的默认值一致
+    if (!engineGiven && (options.mode == "seq" || options.mode == "mt")) {
+        options.transfer.sendEngine = SendEngine::ZeroCopy;
+    }
+    if (!options.transfer.autoTuneStreams) {
+        options.transfer.directoryStreams = options.threads;
+    }
+    return true;
+}
+
+int CommandLine::run(const CommandLineOptions& options) {
+    Logger::setLevel(options.logLevel);
+    std::string serverIP = options.serverIP;
+    int serverPort = options.serverPort;
+    if (serverIP.empty() && !NetworkUtils::discoverServer(serverIP, serverPort)) {
+        std::cerr << " 无法发现服务器，程序退出" << std::endl;
+        return 1;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    bool ok = true;
+    try {
+        TransferHandlers transferHandler(serverIP, serverPort, options.transfer);
+
+        if (options.mode == "seq") {
+            transferHandler.sequentialTransfer(options.path);
+        } else if (options.mode == "mt") {
+            transferHandler.multithreadedTransfer(options.path, options.threads);
+        } else if (options.mode == "dir") {
+            transferHandler.directoryTransfer(options.path);
+        } else if (options.mode == "delta") {
+            transferHandler.deltaTransfer(options.path);
+        } else if (options.mode == "get") {
+            transferHandler.downloadFile(options.path, options.localDir, options.threads);
+        } else {
+            transferHandler.downloadDirectory(options.path, options.localDir);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "\n 传输失败: " << e.what() << std::endl;
+        ok = false;
+    }
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    if (!options.reportPath.empty()) {
+        writeReport(options, ok, wallMs);
+    }
+    return ok ? 0 : 1;
+}
+
+void CommandLine::printUsage(const char* program) {
+    std::cout << "用法:\n"
+              << "  " << program << "                          自动发现服务器并进入交互模式\n"
+              << "  " << program << " --mode 模式 [选项] 路径    执行一次传输后退出\n\n"
+              << "模式:\n"
+              << "  seq       顺序传输文件\n"
+              << "  mt        多线程传输文件\n"
+              << "  dir       传输文件夹\n"
+              << "  delta     增量同步文件\n"
+              << "  get       下载文件 (路径为服务器上的路径)\n"
+              << "  getdir    下载文件夹\n\n"
+              << "选项:\n"
+              << "  --server IP:端口                 不指定时广播发现服务器\n"
+              << "  --threads N|auto                 线程数 (1-16) 或自动调节 [4]\n"
+              << "  --chunk-mb N                     块大小 MB (1-64) [16]\n"
+              << "  --engine buffered|sendfile       发送引擎 [sendfile]；v2 计算校验和时按 buffered 发送\n"
+              << "  --compress none|fast|high        压缩 [none]\n"
+              << "  --sync full|incremental|mirror   文件夹同步方式 [full]\n"
+              << "  --resume | --restart             顺序传输遇到断点时继续或重新开始，未指定时报错退出\n"
+              << "  --dest 目录                      下载保存目录 [.]\n"
+              << "  --report 文件                    结束后追加一行 JSON: 状态、耗时、CPU 时间、峰值内存、I/O 系统调用数\n"
+              << "  --metrics 文件                   定期追加写入传输指标 (计数器、延迟和大小分布)，每次传输结束另写一行汇总\n"
+              << "  --metrics-interval MS            指标写入间隔 [1000]\n"
+              << "  --trace 文件                     记录各块、各连接的阶段时间线，写成 Chrome trace JSON\n"
+              << "  --log-level debug|info|warn|error  传输过程中的输出级别，warn 不显示进度 [info]\n";
+}
@@ -0,0 +1,28 @@
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include <string>
+#include "transfer_handlers.h"
+
+// 非交互模式: 由命令行参数直接执行一次传输，供脚本和基准测试使用
+struct CommandLineOptions {
+    std::string serverIP;           // 为空时广播发现服务器
+    int serverPort = 0;
+    std::string mode;               // seq, mt, dir, delta, get, getdir
+    std::string path;
+    std::string localDir = ".";
+    int threads = 4;
+    std::string reportPath;         // 非空时结束后追加一行 JSON 结果
+    LogLevel logLevel = LogLevel::Info;
+    TransferOptions transfer;
+};
+
+class CommandLine {
+public:
+    // 没有参数时返回 false，由调用方进入交互模式；参数错误时抛出
+    static bool parse(int argc, char* argv[], CommandLineOptions& options);
+    static int run(const CommandLineOptions& options);
+    static void printUsage(const char* program);
+};
+
+#endif
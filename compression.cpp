@@ -0,0 +1,367 @@
+#include "compression.h"
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+namespace {
+
+const size_t MIN_MATCH = 4;
+const size_t LAST_LITERALS = 5;    // 块末尾至少保留的字面量字节
+const size_t MF_LIMIT = 12;        // 最后一个匹配必须在此距离之前开始
+const size_t MAX_DISTANCE = 65535;
+const int FAST_HASH_LOG = 12;
+const int HIGH_HASH_LOG = 15;
+const int HIGH_MAX_ATTEMPTS = 64;
+const int MAX_BYPASS_WINDOW = 32;
+
+inline uint32_t read32(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t hash4(uint32_t value, int hashLog) {
+    return (value * 2654435761u) >> (32 - hashLog);
+}
+
+inline size_t matchLength(const unsigned char* ip, const unsigned char* ref, const unsigned char* limit) {
+    const unsigned char* start = ip;
+    // 每次比较 8 字节，用第一个不同位的位置算出公共前缀
+    while (ip + sizeof(uint64_t) <= limit) {
+        uint64_t a;
+        uint64_t b;
+        memcpy(&a, ip, sizeof(a));
+        memcpy(&b, ref, sizeof(b));
+        if (a != b) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return ip - start + (__builtin_ctzll(a ^ b) >> 3);
+#else
+            return ip - start + (__builtin_clzll(a ^ b) >> 3);
+#endif
+        }
+        ip += sizeof(uint64_t);
+        ref += sizeof(uint64_t);
+    }
+    while (ip < limit && *ip == *ref) {
+        ip++;
+        ref++;
+    }
+    return ip - start;
+}
+
+inline void writeLength(unsigned char*& op, size_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = static_cast<unsigned char>(length);
+}
+
+// 写出一个序列；match 为 0 表示只有字面量的末尾序列
+bool emitSequence(unsigned char*& op, const unsigned char* oend, const unsigned char* literals,
+                  size_t literalLength, size_t offset, size_t match) {
+    size_t needed = 1 + literalLength + literalLength / 255 + 1 + (match ? 3 + match / 255 : 0);
+    if (op + needed > oend) {
+        return false;
+    }
+
+    unsigned char* token = op++;
+    if (literalLength >= 15) {
+        *token = 15 << 4;
+        writeLength(op, literalLength - 15);
+    } else {
+        *token = static_cast<unsigned char>(literalLength << 4);
+    }
+    memcpy(op, literals, literalLength);
+    op += literalLength;
+
+    if (match) {
+        *op++ = static_cast<unsigned char>(offset);
+        *op++ = static_cast<unsigned char>(offset >> 8);
+        size_t extra = match - MIN_MATCH;
+        if (extra >= 15) {
+            *token |= 15;
+            writeLength(op, extra - 15);
+        } else {
+            *token |= static_cast<unsigned char>(extra);
+        }
+    }
+    return true;
+}
+
+size_t compressFast(const unsigned char* src, size_t length, unsigned char* dst, size_t capacity) {
+    thread_local uint32_t table[1 << FAST_HASH_LOG];
+    memset(table, 0, sizeof(table));
+
+    const unsigned char* ip = src;
+    const unsigned char* anchor = src;
+    const unsigned char* iend = src + length;
+    const unsigned char* mflimit = iend - MF_LIMIT;
+    const unsigned char* matchLimit = iend - LAST_LITERALS;
+    unsigned char* op = dst;
+    unsigned char* oend = dst + capacity;
+    unsigned misses = 0;
+
+    while (ip < mflimit) {
+        uint32_t h = hash4(read32(ip), FAST_HASH_LOG);
+        const unsigned char* ref = src + table[h];
+        table[h] = static_cast<uint32_t>(ip - src);
+
+        if (ref >= ip || ip - ref > static_cast<ptrdiff_t>(MAX_DISTANCE) || read32(ref) != read32(ip)) {
+            // 连续未命中时逐渐加大步长，快速越过不可压缩区域
+            ip += 1 + (misses++ >> 6);
+            continue;
+        }
+        misses = 0;
+
+        while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+            ip--;
+            ref--;
+        }
+        size_t match = MIN_MATCH + matchLength(ip + MIN_MATCH, ref + MIN_MATCH, matchLimit);
+        if (!emitSequence(op, oend, anchor, ip - anchor, ip - ref, match)) {
+            return 0;
+        }
+        ip += match;
+        anchor = ip;
+        if (ip < mflimit) {
+            table[hash4(read32(ip - 2), FAST_HASH_LOG)] = static_cast<uint32_t>(ip - 2 - src);
+        }
+    }
+
+    if (!emitSequence(op, oend, anchor, iend - anchor, 0, 0)) {
+        return 0;
+    }
+    return op - dst;
+}
+
+size_t compressHigh(const unsigned char* src, size_t length, unsigned char* dst, size_t capacity) {
+    thread_local int32_t head[1 << HIGH_HASH_LOG];
+    thread_local uint16_t chain[MAX_DISTANCE + 1];
+    std::fill(head, head + (1 << HIGH_HASH_LOG), -1);
+
+    const unsigned char* ip = src;
+    const unsigned char* anchor = src;
+    const unsigned char* iend = src + length;
+    const unsigned char* mflimit = iend - MF_LIMIT;
+    const unsigned char* matchLimit = iend - LAST_LITERALS;
+    unsigned char* op = dst;
+    unsigned char* oend = dst + capacity;
+    size_t nextInsert = 0;
+    unsigned misses = 0;
+
+    while (ip < mflimit) {
+        size_t pos = ip - src;
+        for (; nextInsert <= pos; nextInsert++) {
+            uint32_t h = hash4(read32(src + nextInsert), HIGH_HASH_LOG);
+            size_t delta = head[h] < 0 ? 0 : nextInsert - head[h];
+            chain[nextInsert & MAX_DISTANCE] = static_cast<uint16_t>(delta > MAX_DISTANCE ? 0 : delta);
+            head[h] = static_cast<int32_t>(nextInsert);
+        }
+
+        // 沿哈希链寻找最长匹配
+        size_t bestLength = 0;
+        size_t bestDistance = 0;
+        size_t candidate = pos;
+        for (int attempt = 0; attempt < HIGH_MAX_ATTEMPTS; attempt++) {
+            size_t delta = chain[candidate & MAX_DISTANCE];
+            if (delta == 0 || candidate < delta) {
+                break;
+            }
+            candidate -= delta;
+            if (pos - candidate > MAX_DISTANCE) {
+                break;
+            }
+            const unsigned char* ref = src + candidate;
+            if (read32(ref) != read32(ip)) {
+                continue;
+            }
+            size_t match = MIN_MATCH + matchLength(ip + MIN_MATCH, ref + MIN_MATCH, matchLimit);
+            if (match > bestLength) {
+                bestLength = match;
+                bestDistance = pos - candidate;
+            }
+        }
+
+        if (bestLength == 0) {
+            ip += 1 + (misses++ >> 6);
+            continue;
+        }
+        misses = 0;
+
+        if (!emitSequence(op, oend, anchor, ip - anchor, bestDistance, bestLength)) {
+            return 0;
+        }
+        ip += bestLength;
+        anchor = ip;
+    }
+
+    if (!emitSequence(op, oend, anchor, iend - anchor, 0, 0)) {
+        return 0;
+    }
+    return op - dst;
+}
+
+inline void putLittleEndian32(char* out, uint32_t value) {
+    for (size_t i = 0; i < sizeof(value); i++) {
+        out[i] = static_cast<char>(value >> (8 * i));
+    }
+}
+
+} // namespace
+
+size_t Lz4Codec::compressBound(size_t length) {
+    return length + length / 255 + 16;
+}
+
+size_t Lz4Codec::compress(const char* src, size_t length, char* dst, size_t capacity, CompressionMode mode) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+    unsigned char* out = reinterpret_cast<unsigned char*>(dst);
+
+    if (length < MF_LIMIT + 1) {
+        unsigned char* op = out;
+        return emitSequence(op, out + capacity, in, length, 0, 0) ? static_cast<size_t>(op - out) : 0;
+    }
+    if (mode == CompressionMode::High) {
+        return compressHigh(in, length, out, capacity);
+    }
+    return compressFast(in, length, out, capacity);
+}
+
+bool Lz4Codec::decompress(const char* src, size_t length, char* dst, size_t rawLength) {
+    const unsigned char* ip = reinterpret_cast<const unsigned char*>(src);
+    const unsigned char* iend = ip + length;
+    unsigned char* op = reinterpret_cast<unsigned char*>(dst);
+    unsigned char* ostart = op;
+    unsigned char* oend = op + rawLength;
+
+    while (ip < iend) {
+        unsigned token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15) {
+            unsigned char extra;
+            do {
+                if (ip >= iend) {
+                    return false;
+                }
+                extra = *ip++;
+                literalLength += extra;
+            } while (extra == 255);
+        }
+        if (literalLength > static_cast<size_t>(iend - ip) || literalLength > static_cast<size_t>(oend - op)) {
+            return false;
+        }
+        memcpy(op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        if (ip == iend) {
+            break;  // 末尾序列没有匹配部分
+        }
+        if (iend - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - ostart)) {
+            return false;
+        }
+
+        size_t match = token & 15;
+        if (match == 15) {
+            unsigned char extra;
+            do {
+                if (ip >= iend) {
+                    return false;
+                }
+                extra = *ip++;
+                match += extra;
+            } while (extra == 255);
+        }
+        match += MIN_MATCH;
+        if (match > static_cast<size_t>(oend - op)) {
+            return false;
+        }
+
+        // 匹配可能与输出重叠 (offset < match)，逐字节复制
+        const unsigned char* ref = op - offset;
+        if (offset >= match) {
+            memcpy(op, ref, match);
+            op += match;
+        } else {
+            for (size_t i = 0; i < match; i++) {
+                *op++ = *ref++;
+            }
+        }
+    }
+
+    return op == oend;
+}
+
+BlockEncoder::BlockEncoder(CompressionMode mode, CompressionStats* stats)
+    : mode(mode), stats(stats), bypassRemaining(0), bypassWindow(1) {}
+
+size_t BlockEncoder::maxEncodedSize(size_t length) {
+    size_t blocks = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    return length + blocks * (BLOCK_HEADER_SIZE + Lz4Codec::compressBound(BLOCK_SIZE) - BLOCK_SIZE);
+}
+
+size_t BlockEncoder::encode(const char* data, size_t length, char* out) {
+    size_t written = 0;
+    while (length > 0) {
+        size_t blockLength = std::min(length, BLOCK_SIZE);
+        written += encodeBlock(data, blockLength, out + written);
+        data += blockLength;
+        length -= blockLength;
+    }
+    return written;
+}
+
+void BlockEncoder::encodeInto(const char* data, size_t length, std::vector<char>& out) {
+    size_t offset = out.size();
+    out.resize(offset + maxEncodedSize(length));
+    out.resize(offset + encode(data, length, out.data() + offset));
+}
+
+size_t BlockEncoder::encodeBlock(const char* data, size_t length, char* out) {
+    char* payload = out + BLOCK_HEADER_SIZE;
+
+    size_t encoded = 0;
+    if (mode != CompressionMode::None && bypassRemaining == 0) {
+        auto start = std::chrono::steady_clock::now();
+        // 至少省下 1/16 才值得让接收端解压
+        encoded = Lz4Codec::compress(data, length, payload, length - length / 16, mode);
+        if (stats) {
+            stats->nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        }
+        if (encoded == 0) {
+            bypassRemaining = bypassWindow;
+            bypassWindow = std::min(bypassWindow * 2, MAX_BYPASS_WINDOW);
+        } else {
+            bypassWindow = 1;
+        }
+    } else if (bypassRemaining > 0) {
+        bypassRemaining--;
+    }
+
+    if (encoded == 0) {
+        memcpy(payload, data, length);
+        encoded = length;
+    }
+
+    putLittleEndian32(out, static_cast<uint32_t>(length));
+    putLittleEndian32(out + 4, static_cast<uint32_t>(encoded));
+
+    if (stats) {
+        stats->rawBytes += length;
+        stats->wireBytes += BLOCK_HEADER_SIZE + encoded;
+        if (encoded < length) {
+            stats->compressedBlocks++;
+        } else {
+            stats->storedBlocks++;
+        }
+    }
+    return BLOCK_HEADER_SIZE + encoded;
+}
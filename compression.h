@@ -0,0 +1,59 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <atomic>
+
+enum class CompressionMode {
+    None,
+    Fast,   // 单次哈希探测，接近 LZ4 默认级别
+    High    // 哈希链搜索最长匹配，压缩比更高、速度较慢
+};
+
+// 内置的 LZ4 块格式编解码，不依赖外部库。
+// 匹配距离不超过 64KB，输出与 lz4 的 LZ4_decompress_safe 兼容。
+class Lz4Codec {
+public:
+    static size_t compressBound(size_t length);
+    // 返回压缩后长度；输出空间不足时返回 0
+    static size_t compress(const char* src, size_t length, char* dst, size_t capacity, CompressionMode mode);
+    static bool decompress(const char* src, size_t length, char* dst, size_t rawLength);
+};
+
+struct CompressionStats {
+    std::atomic<long long> rawBytes{0};
+    std::atomic<long long> wireBytes{0};
+    std::atomic<long long> compressedBlocks{0};
+    std::atomic<long long> storedBlocks{0};
+    std::atomic<long long> nanos{0};
+};
+
+// 把数据编码为块流: 每块 rawLength(4) + encodedLength(4) + 数据，小端序。
+// encodedLength == rawLength 表示原样存储，否则为 LZ4 块。
+// 压不动的数据 (已压缩的媒体等) 会触发退避，之后若干块直接存储不再尝试。
+class BlockEncoder {
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t BLOCK_HEADER_SIZE = 8;
+
+    BlockEncoder(CompressionMode mode, CompressionStats* stats);
+
+    static size_t maxEncodedSize(size_t length);
+
+    // 写入 out (至少 maxEncodedSize(length) 字节)，返回写入长度；length 超过 BLOCK_SIZE 时自动切分
+    size_t encode(const char* data, size_t length, char* out);
+    // 追加到 out 末尾
+    void encodeInto(const char* data, size_t length, std::vector<char>& out);
+
+private:
+    size_t encodeBlock(const char* data, size_t length, char* out);
+
+    CompressionMode mode;
+    CompressionStats* stats;
+    int bypassRemaining;   // 剩余直接存储的块数
+    int bypassWindow;      // 下一次退避的块数，连续失败时翻倍
+};
+
+#endif
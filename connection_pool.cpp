@@ -0,0 +1,113 @@
+#include "connection_pool.h"
+#include "network_utils.h"
+#include "metrics.h"
+#include "trace.h"
+#include <map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+namespace {
+
+struct IdleConnection {
+    int socket;
+    std::chrono::steady_clock::time_point since;
+};
+
+struct PoolState {
+    std::mutex mutex;
+    std::map<std::string, std::vector<IdleConnection>> idle;
+};
+
+std::atomic<long long> acquireCount{0};
+std::atomic<long long> connectCount{0};
+std::atomic<long long> reuseCount{0};
+
+// 与 BufferPool 一样有意不析构，进程退出时由内核关闭剩余连接
+PoolState& poolState() {
+    static PoolState* state = new PoolState();
+    return *state;
+}
+
+// 每个线程复用同一个键缓冲区，取还连接时不再分配
+const std::string& poolKey(const std::string& serverIP, int serverPort) {
+    thread_local std::string key;
+    key.assign(serverIP);
+    key += ':';
+    key += std::to_string(serverPort);
+    return key;
+}
+
+// 空闲连接在帧边界上不应有可读数据: 可读说明对端已关闭 (EOF) 或协议状态错乱
+bool stillUsable(int socket) {
+    struct pollfd pfd = {socket, POLLIN, 0};
+    return poll(&pfd, 1, 0) == 0;
+}
+
+} // namespace
+
+int ConnectionPool::acquire(const std::string& serverIP, int serverPort) {
+    acquireCount++;
+    TraceSpan acquireSpan("connection", "acquire_connection");
+    const std::string& key = poolKey(serverIP, serverPort);
+    auto now = std::chrono::steady_clock::now();
+
+    while (true) {
+        IdleConnection connection{-1, {}};
+        {
+            PoolState& state = poolState();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            auto it = state.idle.find(key);
+            if (it == state.idle.end() || it->second.empty()) {
+                break;
+            }
+            // 后进先出: 最近用过的连接拥塞窗口最大，也最不可能已被回收
+            connection = it->second.back();
+            it->second.pop_back();
+        }
+
+        if (now - connection.since < std::chrono::seconds(IDLE_TIMEOUT_SECONDS) && stillUsable(connection.socket)) {
+            reuseCount++;
+            Metrics::add(Counter::ConnectionsReused);
+            acquireSpan.arg("reused", 1);
+            return connection.socket;
+        }
+        close(connection.socket);
+    }
+
+    MetricsTimer connectTimer(Histogram::ConnectUs);
+    TraceSpan connectSpan("connection", "connect");
+    int socket = NetworkUtils::createConnection(serverIP, serverPort);
+    connectTimer.stop();
+    connectSpan.end();
+    connectCount++;
+    Metrics::add(Counter::ConnectionsOpened);
+    int keepAlive = 1;
+    setsockopt(socket, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof(keepAlive));
+    return socket;
+}
+
+void ConnectionPool::release(int socket, const std::string& serverIP, int serverPort, bool reusable) {
+    if (socket < 0) {
+        return;
+    }
+
+    if (reusable) {
+        PoolState& state = poolState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        std::vector<IdleConnection>& idle = state.idle[poolKey(serverIP, serverPort)];
+        if (static_cast<int>(idle.size()) < IDLE_LIMIT) {
+            idle.push_back({socket, std::chrono::steady_clock::now()});
+            return;
+        }
+    }
+    close(socket);
+}
+
+ConnectionPool::Stats ConnectionPool::stats() {
+    return {acquireCount.load(), connectCount.load(), reuseCount.load()};
+}
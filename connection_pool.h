@@ -0,0 +1,28 @@
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <string>
+
+// 到服务器的长连接池，进程内所有传输共享，按服务器地址分组。
+// 服务器在 HelloAck 中声明 CAPABILITY_KEEPALIVE 时，一次请求在帧边界完整结束后连接归还到池中，
+// 后续请求 (包括之后的传输任务) 直接复用已完成握手、拥塞窗口已经打开的连接。
+// 不支持的服务器 (包括 v1) 归还时直接关闭，行为与每次新建连接相同。
+class ConnectionPool {
+public:
+    static constexpr int IDLE_LIMIT = 16;               // 每个服务器地址最多保留的空闲连接
+    static constexpr int IDLE_TIMEOUT_SECONDS = 30;     // 空闲更久的连接可能已被服务器或中间设备回收
+
+    struct Stats {
+        long long acquires;
+        long long connects;     // 实际新建 TCP 连接的次数
+        long long reuses;
+    };
+
+    // 优先取最近归还的空闲连接，已被对端关闭或超时的丢弃；没有可用连接时新建
+    static int acquire(const std::string& serverIP, int serverPort);
+    // reusable 为 false (连接状态未知、出错或服务器不保持连接) 时直接关闭
+    static void release(int socket, const std::string& serverIP, int serverPort, bool reusable);
+    static Stats stats();
+};
+
+#endif
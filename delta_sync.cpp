@@ -0,0 +1,189 @@
+#include "delta_sync.h"
+#include "checksum.h"
+#include "buffer_pool.h"
+#include "wire_protocol.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+DeltaEncoder::DeltaEncoder(int socket, size_t blockSize, const std::vector<BlockSignature>& signatures)
+    : socket(socket), blockSize(blockSize), signatures(signatures), runStart(0), runLength(0), fileCrc(0) {
+    weakIndex.reserve(signatures.size());
+    for (uint32_t i = 0; i < signatures.size(); i++) {
+        weakIndex[signatures[i].weak].push_back(i);
+    }
+}
+
+uint32_t DeltaEncoder::weakChecksum(const char* data, size_t length) {
+    uint32_t a = 0;
+    uint32_t b = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = data[i];
+        a += c;
+        b += (length - i) * c;
+    }
+    return (a & 0xffff) | (b << 16);
+}
+
+uint32_t DeltaEncoder::rollChecksum(uint32_t checksum, unsigned char out, unsigned char in, size_t blockSize) {
+    uint32_t a = checksum & 0xffff;
+    uint32_t b = checksum >> 16;
+    a = (a - out + in) & 0xffff;
+    b = (b - blockSize * out + a) & 0xffff;
+    return a | (b << 16);
+}
+
+int DeltaEncoder::findMatch(const char* block, uint32_t weak) const {
+    auto it = weakIndex.find(weak);
+    if (it == weakIndex.end()) {
+        return -1;
+    }
+
+    // 弱校验命中后才计算强校验
+    uint64_t strong = Checksum::xxh64(block, blockSize);
+    for (uint32_t index : it->second) {
+        if (signatures[index].strong == strong) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+// 文件按窗口 pread 读入，不做 mmap: 编码期间文件被截断时，访问映射中越过文件末尾的页会收到 SIGBUS。
+// 窗口中只保留尚未发出的字面数据和待匹配的数据，读满前把它们移到窗口开头
+bool DeltaEncoder::encode(int fd, long long size) {
+    PooledBuffer window = BufferPool::acquire(DELTA_WINDOW_SIZE);
+    char* data = window.data();
+    size_t length = 0;          // 窗口中的有效字节
+    long long readOffset = 0;   // 下一次读取的文件位置
+    size_t pos = 0;
+    size_t literalStart = 0;
+    uint32_t weak = 0;
+    bool weakValid = false;
+    fileCrc = 0;
+
+    auto refill = [&]() {
+        memmove(data, data + literalStart, length - literalStart);
+        length -= literalStart;
+        pos -= literalStart;
+        literalStart = 0;
+        while (length < DELTA_WINDOW_SIZE && readOffset < size) {
+            size_t toRead = std::min(static_cast<long long>(DELTA_WINDOW_SIZE - length), size - readOffset);
+            ssize_t bytesRead = pread(fd, data + length, toRead, readOffset);
+            if (bytesRead < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytesRead <= 0) {
+                throw std::runtime_error("读取文件失败，文件可能在同步过程中被截断");
+            }
+            fileCrc = Checksum::crc32c(fileCrc, data + length, bytesRead);
+            length += bytesRead;
+            readOffset += bytesRead;
+        }
+    };
+
+    while (true) {
+        if (pos + blockSize > length && readOffset < size) {
+            refill();
+        }
+
+        if (signatures.empty() || pos + blockSize > length) {
+            if (readOffset >= size) {
+                break;
+            }
+            // 没有可匹配的块，整个窗口都是字面数据
+            pos = std::min(length, literalStart + DELTA_LITERAL_FLUSH);
+            if (!flushLiteral(data + literalStart, pos - literalStart)) {
+                return false;
+            }
+            literalStart = pos;
+            continue;
+        }
+
+        if (!weakValid) {
+            weak = weakChecksum(data + pos, blockSize);
+            weakValid = true;
+        }
+
+        int match = findMatch(data + pos, weak);
+        if (match >= 0) {
+            if (!flushLiteral(data + literalStart, pos - literalStart)) {
+                return false;
+            }
+
+            // 相邻块号合并为一次引用
+            if (runLength > 0 && runStart + runLength == static_cast<uint32_t>(match)) {
+                runLength++;
+            } else {
+                if (!flushCopy()) {
+                    return false;
+                }
+                runStart = match;
+                runLength = 1;
+            }
+            deltaStats.matchedBytes += blockSize;
+
+            pos += blockSize;
+            literalStart = pos;
+            weakValid = false;
+            continue;
+        }
+
+        // 下一字节还没读入窗口时，读入后重新计算
+        if (pos + blockSize < length) {
+            weak = rollChecksum(weak, data[pos], data[pos + blockSize], blockSize);
+        } else {
+            weakValid = false;
+        }
+        pos++;
+
+        if (pos - literalStart >= DELTA_LITERAL_FLUSH) {
+            if (!flushLiteral(data + literalStart, pos - literalStart)) {
+                return false;
+            }
+            literalStart = pos;
+        }
+    }
+
+    if (!flushLiteral(data + literalStart, length - literalStart) || !flushCopy()) {
+        return false;
+    }
+
+    WireMessage end(FrameType::DeltaEnd);
+    end.put(static_cast<uint64_t>(size));
+    end.put(fileCrc);
+    deltaStats.wireBytes += end.size();
+    return end.sendAll(socket);
+}
+
+bool DeltaEncoder::flushLiteral(const char* data, size_t length) {
+    if (length == 0) {
+        return true;
+    }
+    if (!flushCopy()) {
+        return false;
+    }
+
+    WireMessage literal(FrameType::DeltaLiteral);
+    literal.put(static_cast<uint32_t>(length));
+    literal.putBytes(data, length);
+    deltaStats.literalBytes += length;
+    deltaStats.wireBytes += literal.size();
+    return literal.sendAll(socket, length);
+}
+
+bool DeltaEncoder::flushCopy() {
+    if (runLength == 0) {
+        return true;
+    }
+
+    WireMessage copy(FrameType::DeltaCopy);
+    copy.put(runStart);
+    copy.put(runLength);
+    deltaStats.copyOps++;
+    deltaStats.wireBytes += copy.size();
+    runLength = 0;
+    return copy.sendAll(socket);
+}
@@ -0,0 +1,65 @@
+#ifndef DELTA_SYNC_H
+#define DELTA_SYNC_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+
+const size_t DELTA_MIN_BLOCK_SIZE = 2 * 1024;
+const size_t DELTA_MAX_BLOCK_SIZE = 128 * 1024;
+const size_t DELTA_LITERAL_FLUSH = 1024 * 1024;   // 字面数据攒够该长度即发出
+// 本地文件的读取窗口，需容纳未发出的字面数据加上两个最大块
+const size_t DELTA_WINDOW_SIZE = 4 * 1024 * 1024;
+const size_t DELTA_SIGNATURE_SIZE = 12;           // weak(4) + strong(8)
+// 服务器签名表的块数上限 (签名表 48 MB)，按最大块计可覆盖 512 GB 的已有副本
+const uint32_t DELTA_MAX_BLOCK_COUNT = 4 * 1024 * 1024;
+
+// DeltaResult 状态: 服务器按 DeltaEnd 中的大小和 CRC32C 校验重建后的文件
+const uint8_t DELTA_RESULT_OK = 0;
+const uint8_t DELTA_RESULT_CHECKSUM_MISMATCH = 1;   // 未替换原文件，客户端改用完整上传
+
+struct BlockSignature {
+    uint32_t weak;
+    uint64_t strong;
+};
+
+struct DeltaStats {
+    long long literalBytes = 0;
+    long long matchedBytes = 0;
+    long long copyOps = 0;
+    long long wireBytes = 0;
+};
+
+// rsync 式增量编码: 服务器给出已有文件每个完整块的弱/强校验，
+// 本地文件按字节滚动匹配，只发送字面数据和块引用。
+// 弱校验加 xxh64 仍可能误配，结束帧附带整个文件的 CRC32C，由服务器校验重建结果
+class DeltaEncoder {
+public:
+    DeltaEncoder(int socket, size_t blockSize, const std::vector<BlockSignature>& signatures);
+
+    // 从 fd 读取前 size 字节编码并发出；文件在读取中被截断时抛出
+    bool encode(int fd, long long size);
+    const DeltaStats& stats() const { return deltaStats; }
+    uint32_t fileChecksum() const { return fileCrc; }
+
+    // Adler-32 风格滚动校验: a 为字节和，b 为加权和
+    static uint32_t weakChecksum(const char* data, size_t length);
+    static uint32_t rollChecksum(uint32_t checksum, unsigned char out, unsigned char in, size_t blockSize);
+
+private:
+    int findMatch(const char* block, uint32_t weak) const;
+    bool flushLiteral(const char* data, size_t length);
+    bool flushCopy();
+
+    int socket;
+    size_t blockSize;
+    const std::vector<BlockSignature>& signatures;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> weakIndex;
+    uint32_t runStart;     // 当前连续块引用的起始块号
+    uint32_t runLength;
+    uint32_t fileCrc;
+    DeltaStats deltaStats;
+};
+
+#endif
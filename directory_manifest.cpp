@@ -0,0 +1,174 @@
+#include "directory_manifest.h"
+#include "wire_protocol.h"
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ManifestBegin 标志位
+const uint8_t MANIFEST_MIRROR_DELETIONS = 1 << 0;
+const uint8_t MANIFEST_HAS_DIGESTS = 1 << 1;
+
+// 每项: 类型(1) + 路径长度(4) + 大小(8) + 修改时间(8 + 4) + 权限(4) [+ 摘要(32)]
+const size_t MANIFEST_ENTRY_FIXED_SIZE = 1 + 4 + 8 + 8 + 4 + 4;
+
+std::vector<ManifestEntry> DirectoryManifest::build(const std::string& basePath, const std::vector<ScanEntry>& items,
+                                                    bool withDigest) {
+    std::vector<ManifestEntry> entries;
+    entries.reserve(items.size());
+
+    for (const auto& item : items) {
+        ManifestEntry entry;
+        entry.path = item.path;
+        entry.isDirectory = item.isDirectory;
+        entry.size = item.size;
+        entry.mtimeSec = item.mtimeSec;
+        entry.mtimeNsec = item.mtimeNsec;
+        entry.mode = item.mode;
+
+        if (withDigest && !item.isDirectory) {
+            if (entry.size == 0) {
+                entry.digest = ChunkDedup::digest(nullptr, 0);
+                entry.hasDigest = true;
+            } else {
+                // 扫描之后文件可能已变化，按打开时的实际大小计算摘要，大小和摘要描述同一份内容
+                int fd = open((basePath + "/" + item.path).c_str(), O_RDONLY);
+                struct stat fileStat;
+                if (fd >= 0 && fstat(fd, &fileStat) == 0) {
+                    entry.size = fileStat.st_size;
+                    entry.hasDigest = ChunkDedup::digestFileRange(fd, 0, entry.size, entry.digest);
+                }
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+        }
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
+
+bool DirectoryManifest::exchange(int socket, const std::string& dirName, const std::vector<ManifestEntry>& entries,
+                                 bool mirrorDeletions, std::vector<int>& needed, int& deletedCount) {
+    needed.clear();
+    deletedCount = 0;
+
+    bool withDigest = std::any_of(entries.begin(), entries.end(),
+                                  [](const ManifestEntry& entry) { return entry.hasDigest; });
+    uint8_t flags = (mirrorDeletions ? MANIFEST_MIRROR_DELETIONS : 0) | (withDigest ? MANIFEST_HAS_DIGESTS : 0);
+
+    // 单项超过帧载荷上限时无法分批，发出开始帧之前就拒绝
+    size_t entrySize = MANIFEST_ENTRY_FIXED_SIZE + (withDigest ? Sha256::DIGEST_SIZE : 0);
+    for (const auto& entry : entries) {
+        if (4 + entrySize + entry.path.size() > MAX_FRAME_PAYLOAD) {
+            throw std::runtime_error("清单项路径过长: " + entry.path);
+        }
+    }
+
+    WireMessage begin(FrameType::ManifestBegin);
+    begin.putString(dirName);
+    begin.put(static_cast<uint32_t>(entries.size()));
+    begin.put(flags);
+    if (!begin.sendAll(socket)) {
+        return false;
+    }
+
+    // 按帧载荷上限分批，整个清单发完后服务器才开始回复
+    size_t first = 0;
+    while (first < entries.size()) {
+        size_t payloadSize = 4;
+        size_t last = first;
+        while (last < entries.size() && payloadSize + entrySize + entries[last].path.size() <= MAX_FRAME_PAYLOAD) {
+            payloadSize += entrySize + entries[last].path.size();
+            last++;
+        }
+
+        WireMessage batch(FrameType::ManifestEntries);
+        batch.put(static_cast<uint32_t>(last - first));
+        for (size_t i = first; i < last; i++) {
+            const ManifestEntry& entry = entries[i];
+            batch.put(static_cast<uint8_t>(entry.isDirectory ? 'D' : 'F'));
+            batch.putString(entry.path);
+            batch.put(static_cast<uint64_t>(entry.size));
+            batch.put(static_cast<int64_t>(entry.mtimeSec));
+            batch.put(entry.mtimeNsec);
+            batch.put(entry.mode);
+            if (withDigest) {
+                batch.putBytes(entry.digest.bytes, sizeof(entry.digest.bytes));
+            }
+        }
+        if (!batch.sendAll(socket)) {
+            return false;
+        }
+        first = last;
+    }
+
+    // 回复可能分多帧: 结束标志(1) + 删除数(4) + 个数(4) + 下标
+    while (true) {
+        std::vector<char> payload;
+        if (!WireReader::recvFrame(socket, FrameType::ManifestNeeded, payload)) {
+            return false;
+        }
+
+        WireReader reader(payload);
+        uint8_t final = reader.get<uint8_t>();
+        uint32_t deleted = reader.get<uint32_t>();
+        uint32_t count = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < count && reader.ok(); i++) {
+            uint32_t index = reader.get<uint32_t>();
+            if (index < entries.size()) {
+                needed.push_back(static_cast<int>(index));
+            }
+        }
+        if (!reader.ok()) {
+            return false;
+        }
+        deletedCount += deleted;
+        if (final) {
+            break;
+        }
+    }
+
+    std::sort(needed.begin(), needed.end());
+    needed.erase(std::unique(needed.begin(), needed.end()), needed.end());
+    return true;
+}
+
+bool DirectoryManifest::requestListing(int socket, const std::string& remoteDir, std::vector<ManifestEntry>& entries) {
+    entries.clear();
+
+    WireMessage request(FrameType::ListRequest);
+    request.putString(remoteDir);
+    if (!request.sendAll(socket)) {
+        return false;
+    }
+
+    // 回复可能分多帧: 结束标志(1) + 个数(4) + 各项
+    while (true) {
+        std::vector<char> payload;
+        if (!WireReader::recvFrame(socket, FrameType::ListEntries, payload)) {
+            return false;
+        }
+
+        WireReader reader(payload);
+        uint8_t final = reader.get<uint8_t>();
+        uint32_t count = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < count && reader.ok(); i++) {
+            ManifestEntry entry;
+            entry.isDirectory = reader.get<uint8_t>() == 'D';
+            entry.path = reader.getString();
+            entry.size = static_cast<long long>(reader.get<uint64_t>());
+            entry.mtimeSec = reader.get<int64_t>();
+            entry.mtimeNsec = reader.get<uint32_t>();
+            entry.mode = reader.get<uint32_t>();
+            entries.push_back(std::move(entry));
+        }
+        if (!reader.ok()) {
+            return false;
+        }
+        if (final) {
+            return true;
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef DIRECTORY_MANIFEST_H
+#define DIRECTORY_MANIFEST_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "chunk_dedup.h"
+#include "directory_scanner.h"
+
+struct ManifestEntry {
+    std::string path;           // 相对于同步根目录
+    bool isDirectory = false;
+    long long size = 0;
+    long long mtimeSec = 0;
+    uint32_t mtimeNsec = 0;
+    uint32_t mode = 0;
+    bool hasDigest = false;
+    ChunkDigest digest;         // 仅在按内容比较时计算
+};
+
+// 增量同步: 传输前把本地目录清单 (路径、大小、修改时间，可选内容摘要) 发给服务器，
+// 服务器与自己的目录树比较后只返回需要传输的项；可选镜像删除服务器上多余的项。
+class DirectoryManifest {
+public:
+    // 属性直接取自扫描结果；按内容比较时另外计算各文件的摘要
+    static std::vector<ManifestEntry> build(const std::string& basePath, const std::vector<ScanEntry>& items,
+                                            bool withDigest);
+
+    // 在一条独立连接上交换清单；needed 返回需要传输的项在 entries 中的下标 (升序)。
+    // 某项超过单帧载荷上限时在发出任何数据之前抛出
+    static bool exchange(int socket, const std::string& dirName, const std::vector<ManifestEntry>& entries,
+                         bool mirrorDeletions, std::vector<int>& needed, int& deletedCount);
+
+    // 下载文件夹时反方向使用同样的清单格式: 服务器列出 remoteDir 下的全部项 (不含摘要)
+    static bool requestListing(int socket, const std::string& remoteDir, std::vector<ManifestEntry>& entries);
+};
+
+#endif
@@ -0,0 +1,216 @@
+#include "directory_scanner.h"
+#include "buffer_pool.h"
+#include "metrics.h"
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <cstring>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const size_t GETDENTS_BUFFER_SIZE = 64 * 1024;
+// 凑批时最多再等待的时间，避免扫描慢时每轮只发很少几项
+const auto SCAN_QUEUE_BATCH_WAIT = std::chrono::milliseconds(20);
+
+namespace {
+
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+void fillAttributes(ScanEntry& entry, const struct stat& fileStat) {
+    entry.size = entry.isDirectory ? 0 : fileStat.st_size;
+    entry.mtimeSec = fileStat.st_mtim.tv_sec;
+    entry.mtimeNsec = static_cast<uint32_t>(fileStat.st_mtim.tv_nsec);
+    entry.mode = fileStat.st_mode & 07777;
+}
+
+} // namespace
+
+DirectoryScanner::DirectoryScanner(const std::string& rootPath, int threadCount)
+    : rootPath(rootPath), threadCount(std::max(1, threadCount)) {
+    rootFd = open(rootPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        throw std::runtime_error("无法打开目录: " + rootPath);
+    }
+}
+
+DirectoryScanner::~DirectoryScanner() {
+    close(rootFd);
+}
+
+void DirectoryScanner::run(const std::function<void(ScanEntry&&)>& onEntry) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.assign(1, "");
+        outstanding = 1;
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; i++) {
+        threads.emplace_back(&DirectoryScanner::scanLoop, this, std::cref(onEntry));
+    }
+    scanLoop(onEntry);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void DirectoryScanner::scanLoop(const std::function<void(ScanEntry&&)>& onEntry) {
+    PooledBuffer buffer = BufferPool::acquire(GETDENTS_BUFFER_SIZE);
+
+    while (true) {
+        std::string relativePath;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            pendingReady.wait(lock, [this]() { return !pending.empty() || outstanding == 0; });
+            if (pending.empty()) {
+                return;
+            }
+            relativePath = std::move(pending.back());
+            pending.pop_back();
+        }
+
+        scanOne(relativePath, buffer.data(), GETDENTS_BUFFER_SIZE, onEntry);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--outstanding == 0) {
+            pendingReady.notify_all();
+        }
+    }
+}
+
+void DirectoryScanner::scanOne(const std::string& relativePath, char* buffer, size_t bufferSize,
+                               const std::function<void(ScanEntry&&)>& onEntry) {
+    int dirFd = relativePath.empty() ? dup(rootFd)
+                                     : openat(rootFd, relativePath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        std::cerr << "无法打开目录: " << rootPath << "/" << relativePath << std::endl;
+        return;
+    }
+
+    // 目录项在打开时取属性，不必在父目录中单独 stat
+    if (!relativePath.empty()) {
+        struct stat dirStat;
+        if (fstat(dirFd, &dirStat) == 0) {
+            ScanEntry entry;
+            entry.path = relativePath;
+            entry.isDirectory = true;
+            fillAttributes(entry, dirStat);
+            onEntry(std::move(entry));
+        }
+    }
+
+    std::vector<std::string> subdirectories;
+    while (true) {
+        long bytes = syscall(SYS_getdents64, dirFd, buffer, bufferSize);
+        if (bytes <= 0) {
+            break;
+        }
+
+        for (long offset = 0; offset < bytes;) {
+            const LinuxDirent64* dirent = reinterpret_cast<const LinuxDirent64*>(buffer + offset);
+            offset += dirent->d_reclen;
+
+            const char* name = dirent->d_name;
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+                continue;
+            }
+
+            std::string childPath = relativePath.empty() ? name : relativePath + "/" + name;
+            unsigned char type = dirent->d_type;
+            if (type == DT_DIR) {
+                subdirectories.push_back(std::move(childPath));
+                continue;
+            }
+            if (type != DT_REG && type != DT_LNK && type != DT_UNKNOWN) {
+                continue;  // 管道、设备、套接字不传输
+            }
+
+            // 符号链接按其指向的文件发送；指向目录的链接不进入，避免链接成环时无限递归
+            struct stat fileStat;
+            int flags = (type == DT_REG) ? AT_SYMLINK_NOFOLLOW : 0;
+            if (fstatat(dirFd, name, &fileStat, flags) != 0) {
+                continue;
+            }
+            if (S_ISDIR(fileStat.st_mode)) {
+                if (type == DT_UNKNOWN) {
+                    struct stat linkStat;
+                    if (fstatat(dirFd, name, &linkStat, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(linkStat.st_mode)) {
+                        subdirectories.push_back(std::move(childPath));
+                    }
+                }
+            } else if (S_ISREG(fileStat.st_mode)) {
+                ScanEntry entry;
+                entry.path = std::move(childPath);
+                fillAttributes(entry, fileStat);
+                onEntry(std::move(entry));
+            }
+        }
+    }
+    close(dirFd);
+
+    if (!subdirectories.empty()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        outstanding += subdirectories.size();
+        for (auto& path : subdirectories) {
+            pending.push_back(std::move(path));
+        }
+        pendingReady.notify_all();
+    }
+}
+
+void ScanQueue::push(ScanEntry&& entry) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notFull.wait(lock, [this]() { return entries.size() < SCAN_QUEUE_LIMIT || closed; });
+    entries.push_back(std::move(entry));
+    notEmpty.notify_one();
+}
+
+void ScanQueue::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    notEmpty.notify_all();
+    notFull.notify_all();
+}
+
+size_t ScanQueue::popBatch(std::vector<ScanEntry>& out, size_t maxItems) {
+    out.clear();
+    std::unique_lock<std::mutex> lock(mutex);
+    notEmpty.wait(lock, [this]() { return !entries.empty() || closed; });
+    notEmpty.wait_for(lock, SCAN_QUEUE_BATCH_WAIT, [this, maxItems]() { return entries.size() >= maxItems || closed; });
+    Metrics::record(Histogram::ScanQueueDepth, entries.size());
+
+    while (!entries.empty() && out.size() < maxItems) {
+        out.push_back(std::move(entries.front()));
+        entries.pop_front();
+    }
+    notFull.notify_all();
+    return out.size();
+}
+
+void CreatedDirectories::add(const std::vector<std::string>& paths) {
+    std::lock_guard<std::mutex> lock(mutex);
+    created.insert(paths.begin(), paths.end());
+    changed.notify_all();
+}
+
+void CreatedDirectories::finish() {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+    changed.notify_all();
+}
+
+void CreatedDirectories::waitFor(const std::string& path) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this, &path]() { return finished || created.count(path) > 0; });
+}
@@ -0,0 +1,87 @@
+#ifndef DIRECTORY_SCANNER_H
+#define DIRECTORY_SCANNER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_set>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+
+const int DEFAULT_SCAN_THREADS = 4;
+const size_t SCAN_QUEUE_LIMIT = 64 * 1024;
+
+struct ScanEntry {
+    std::string path;           // 相对于扫描根目录
+    bool isDirectory = false;
+    long long size = 0;
+    long long mtimeSec = 0;
+    uint32_t mtimeNsec = 0;
+    uint32_t mode = 0;
+};
+
+// 多线程目录扫描: 各目录相对根目录 fd 用 openat() 打开，getdents64 批量读取目录项，
+// 按 d_type 判断类型，属性用相对目录 fd 的 fstatat() 获取，不再逐项拼完整路径 stat()。
+// 待扫描目录只保存相对路径，同时打开的目录 fd 数不超过扫描线程数。
+// 指向目录的符号链接不进入。
+class DirectoryScanner {
+public:
+    DirectoryScanner(const std::string& rootPath, int threadCount = DEFAULT_SCAN_THREADS);
+    ~DirectoryScanner();
+
+    DirectoryScanner(const DirectoryScanner&) = delete;
+    DirectoryScanner& operator=(const DirectoryScanner&) = delete;
+
+    // 扫描整棵树，直到完成才返回；onEntry 会在多个扫描线程中并发调用
+    void run(const std::function<void(ScanEntry&&)>& onEntry);
+
+private:
+    void scanLoop(const std::function<void(ScanEntry&&)>& onEntry);
+    void scanOne(const std::string& relativePath, char* buffer, size_t bufferSize,
+                 const std::function<void(ScanEntry&&)>& onEntry);
+
+    std::string rootPath;
+    int rootFd;
+    int threadCount;
+
+    std::mutex mutex;
+    std::condition_variable pendingReady;
+    std::vector<std::string> pending;   // 待扫描目录 (后进先出，深度优先)
+    size_t outstanding = 0;             // 排队中和扫描中的目录数，归零即扫描结束
+};
+
+// 扫描结果到发送流之间的有界队列，队列满时扫描线程等待发送方
+class ScanQueue {
+public:
+    void push(ScanEntry&& entry);
+    void close();
+    // 至少等到一项 (或队列关闭)，再在短时间内尽量凑满 maxItems；返回 0 表示已关闭且取空
+    size_t popBatch(std::vector<ScanEntry>& out, size_t maxItems);
+
+private:
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<ScanEntry> entries;
+    bool closed = false;
+};
+
+// 已在服务器上建好的目录 (相对路径，根目录为空串)。目录结构流发完一轮后登记，
+// 等待某个目录的一方在它登记后或结构流结束后返回
+class CreatedDirectories {
+public:
+    void add(const std::vector<std::string>& paths);
+    void finish();
+    void waitFor(const std::string& path);
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::unordered_set<std::string> created;
+    bool finished = false;
+};
+
+#endif
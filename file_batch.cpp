@@ -0,0 +1,118 @@
+#include "file_batch.h"
+#include "network_utils.h"
+#include "wire_protocol.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// v2 文件表中每项的固定部分: 路径长度(4) + 属性(44) + 大小(8)
+const size_t BATCH_ENTRY_FIXED_SIZE = 4 + 44 + 8;
+
+FileBatch::FileBatch(int protocolVersion, size_t capacity, long long fileThreshold,
+                     CompressionMode compression, CompressionStats* stats)
+    : protocolVersion(protocolVersion), capacity(capacity), fileThreshold(fileThreshold),
+      data(BufferPool::acquire(capacity + fileThreshold)), dataSize(0),
+      compression(protocolVersion >= 2 ? compression : CompressionMode::None), stats(stats),
+      tableBytes(sizeof(uint32_t)), pendingFiles(0) {}
+
+BatchResult FileBatch::add(const std::string& relativePath, const std::string& fullPath) {
+    int fd = open(fullPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return BatchResult::Failed;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        close(fd);
+        return BatchResult::Failed;
+    }
+    if (!S_ISREG(fileStat.st_mode) || fileStat.st_size > fileThreshold) {
+        close(fd);
+        return BatchResult::TooLarge;
+    }
+
+    // 直接读入批缓冲区尾部，不经过 ifstream 和临时缓冲
+    // 未满时追加的文件不超过阈值，因此不会越过 capacity + fileThreshold
+    size_t offset = dataSize;
+    size_t bytesRead = 0;
+    while (bytesRead < static_cast<size_t>(fileStat.st_size)) {
+        ssize_t result = read(fd, data.data() + offset + bytesRead, fileStat.st_size - bytesRead);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        bytesRead += result;
+    }
+    close(fd);
+
+    if (bytesRead != static_cast<size_t>(fileStat.st_size)) {
+        return BatchResult::Failed;
+    }
+    dataSize += bytesRead;
+
+    entries.push_back({relativePath, NetworkUtils::attributesFromStat(fileStat), offset, bytesRead});
+    tableBytes += BATCH_ENTRY_FIXED_SIZE + relativePath.size();
+    pendingFiles++;
+    return BatchResult::Added;
+}
+
+bool FileBatch::full() const {
+    return dataSize >= capacity || tableBytes + BATCH_ENTRY_FIXED_SIZE + 4096 > MAX_FRAME_PAYLOAD;
+}
+
+bool FileBatch::flush(int socket) {
+    if (pendingFiles == 0) {
+        return true;
+    }
+
+    bool sent = false;
+    if (compression != CompressionMode::None) {
+        // 每批单独编码，退避状态不跨批保留
+        BlockEncoder encoder(compression, stats);
+        if (encoded.data() == nullptr) {
+            encoded = BufferPool::acquire(BlockEncoder::maxEncodedSize(capacity + fileThreshold));
+        }
+        size_t encodedSize = encoder.encode(data.data(), dataSize, encoded.data());
+
+        WireMessage batch(FrameType::CompressedFileBatch);
+        batch.put(static_cast<uint32_t>(entries.size()));
+        for (const auto& entry : entries) {
+            batch.putString(entry.relativePath);
+            batch.putAttributes(entry.attrs);
+            batch.put(static_cast<uint64_t>(entry.size));
+        }
+        batch.putBytes(encoded.data(), encodedSize);
+        sent = batch.sendAll(socket, encodedSize);
+    } else if (protocolVersion >= 2) {
+        WireMessage batch(FrameType::FileBatch);
+        batch.put(static_cast<uint32_t>(entries.size()));
+        for (const auto& entry : entries) {
+            batch.putString(entry.relativePath);
+            batch.putAttributes(entry.attrs);
+            batch.put(static_cast<uint64_t>(entry.size));
+        }
+        // 帧载荷只含文件表，内容紧随其后
+        batch.putBytes(data.data(), dataSize);
+        sent = batch.sendAll(socket, dataSize);
+    } else {
+        WireMessage batch;
+        for (const auto& entry : entries) {
+            batch.putNative('F');
+            batch.putNative(static_cast<int>(entry.relativePath.size()));
+            batch.putBytes(entry.relativePath.data(), entry.relativePath.size());
+            batch.putNative(entry.attrs);
+            batch.putNative(static_cast<long long>(entry.size));
+            batch.putBytes(data.data() + entry.offset, entry.size);
+        }
+        sent = batch.sendAll(socket);
+    }
+
+    entries.clear();
+    dataSize = 0;
+    tableBytes = sizeof(uint32_t);
+    pendingFiles = 0;
+    return sent;
+}
@@ -0,0 +1,54 @@
+#ifndef FILE_BATCH_H
+#define FILE_BATCH_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "../common/file_attributes.h"
+#include "compression.h"
+#include "buffer_pool.h"
+
+enum class BatchResult {
+    Added,
+    TooLarge,   // 超过打包阈值，应按普通文件单独发送
+    Failed
+};
+
+// 把多个小文件合并成一条大记录，用少量大块写出。
+// v1: 依次拼接与 sendDirectoryFile 相同布局的文件记录，旧服务器按原流程逐个解析；
+// v2: 一个 FileBatch 帧，载荷为文件表 (路径、属性、大小)，其后紧跟全部文件内容；
+//     启用压缩时改用 CompressedFileBatch 帧，内容部分编码为 BlockEncoder 块流。
+// 缓冲区从 BufferPool 借出并在多次 flush 之间复用，热路径上不再为每个文件分配内存。
+class FileBatch {
+public:
+    FileBatch(int protocolVersion, size_t capacity, long long fileThreshold,
+              CompressionMode compression = CompressionMode::None, CompressionStats* stats = nullptr);
+
+    BatchResult add(const std::string& relativePath, const std::string& fullPath);
+    bool full() const;
+    bool empty() const { return pendingFiles == 0; }
+    int size() const { return pendingFiles; }
+    bool flush(int socket);
+
+private:
+    struct Entry {
+        std::string relativePath;
+        FileAttributes attrs;
+        size_t offset;
+        size_t size;
+    };
+
+    int protocolVersion;
+    size_t capacity;
+    long long fileThreshold;
+    std::vector<Entry> entries;
+    PooledBuffer data;         // 所有待发文件内容依次拼接
+    size_t dataSize;
+    PooledBuffer encoded;      // 压缩后的块流，首次压缩时借出
+    CompressionMode compression;
+    CompressionStats* stats;
+    size_t tableBytes;         // v2 文件表的编码长度
+    int pendingFiles;
+};
+
+#endif
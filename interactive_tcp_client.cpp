@@ -1,5 +1,6 @@
 #include "interactive_tcp_client.h"
 #include "transfer_handlers.h"
+#include "../common/constants.h"
 #include <iostream>
 #include <string>
 #include <sys/stat.h>
@@ -19,8 +20,11 @@ void InteractiveTCPClient::runInteractive() {
         std::cout << "1. 顺序传输文件" << std::endl;
         std::cout << "2. 多线程传输文件" << std::endl;
         std::cout << "3. 传输文件夹" << std::endl;
+        std::cout << "4. 增量同步文件" << std::endl;
+        std::cout << "5. 下载文件" << std::endl;
+        std::cout << "6. 下载文件夹" << std::endl;
         std::cout << "q. 退出客户端" << std::endl;
-        std::cout << "请输入选择 (1/2/3/q): ";
+        std::cout << "请输入选择 (1/2/3/4/5/6/q): ";
         
         std::string choice;
         std::getline(std::cin, choice);
@@ -35,13 +39,13 @@ void InteractiveTCPClient::runInteractive() {
 }
 
 void InteractiveTCPClient::handleUserChoice(const std::string& choice) {
-    if (choice != "1" && choice != "2" && choice != "3") {
-        std::cout << " 无效选择，请输入 1, 2, 3 或 q" << std::endl;
+    if (choice != "1" && choice != "2" && choice != "3" && choice != "4" && choice != "5" && choice != "6") {
+        std::cout << " 无效选择，请输入 1, 2, 3, 4, 5, 6 或 q" << std::endl;
         return;
     }
     
     std::string path;
-    if (choice == "1" || choice == "2") {
+    if (choice == "1" || choice == "2" || choice == "4") {
         std::cout << " 请输入文件路径: ";
         std::getline(std::cin, path);
         
@@ -56,15 +60,51 @@ void InteractiveTCPClient::handleUserChoice(const std::string& choice) {
             return;
         }
     }
+
+    std::string localDir;
+    if (choice == "5" || choice == "6") {
+        std::cout << (choice == "5" ? " 请输入服务器上的文件路径: " : " 请输入服务器上的文件夹路径: ");
+        std::getline(std::cin, path);
+        if (path.empty()) {
+            std::cout << " 路径不能为空" << std::endl;
+            return;
+        }
+
+        localDir = getLocalDirectory();
+        if (!validateFilePath(localDir, false)) {
+            return;
+        }
+    }
     
-    int threadCount = (choice == "2") ? getThreadCount() : 4;
+    int threadCount = (choice == "2" || choice == "3" || choice == "5" || choice == "6") ? getThreadCount() : 4;
+
+    // 0 表示按实测吞吐自动调节分块传输的并行流数，块大小也随之自动选择
+    TransferOptions options;
+    options.autoTuneStreams = (threadCount == 0);
+    if (options.autoTuneStreams) {
+        threadCount = MAX_THREADS;
+    } else {
+        options.directoryStreams = threadCount;
+    }
+    if ((choice == "2" || choice == "5") && !options.autoTuneStreams) {
+        options.chunkSize = getChunkSize();
+    }
+    if (choice == "1" || choice == "2") {
+        options.sendEngine = getSendEngine();
+    }
+    if (choice == "2" || choice == "3") {
+        options.compression = getCompression();
+    }
+    if (choice == "3") {
+        options.syncMode = getSyncMode();
+    }
     
     std::cout << "\n========================================" << std::endl;
     std::cout << "       开始传输..." << std::endl;
     std::cout << "========================================\n" << std::endl;
 
     try {
-        TransferHandlers transferHandler(serverIP, serverPort);
+        TransferHandlers transferHandler(serverIP, serverPort, options);
         
         if (choice == "1") {
             transferHandler.sequentialTransfer(path);
@@ -72,6 +112,12 @@ void InteractiveTCPClient::handleUserChoice(const std::string& choice) {
             transferHandler.multithreadedTransfer(path, threadCount);
         } else if (choice == "3") {
             transferHandler.directoryTransfer(path);
+        } else if (choice == "4") {
+            transferHandler.deltaTransfer(path);
+        } else if (choice == "5") {
+            transferHandler.downloadFile(path, localDir, threadCount);
+        } else if (choice == "6") {
+            transferHandler.downloadDirectory(path, localDir);
         }
         
         std::cout << "\n 传输任务完成!" << std::endl;
@@ -104,15 +150,77 @@ bool InteractiveTCPClient::validateFilePath(const std::string& path, bool isFile
 }
 
 int InteractiveTCPClient::getThreadCount() {
-    std::cout << " 请输入线程数量 (1-16): ";
+    std::cout << " 请输入线程数量 (1-16, 0=自动调节): ";
     std::string threadInput;
     std::getline(std::cin, threadInput);
     
     try {
         int threadCount = std::stoi(threadInput);
+        if (threadCount == 0) {
+            return 0;
+        }
         return std::max(1, std::min(threadCount, 16));
     } catch (...) {
         std::cout << " 使用默认线程数: 4" << std::endl;
         return 4;
     }
-}
\ No newline at end of file
+}
+
+long long InteractiveTCPClient::getChunkSize() {
+    std::cout << " 请输入块大小 MB (1-64) [" << DEFAULT_CHUNK_SIZE / (1024 * 1024) << "]: ";
+    std::string sizeInput;
+    std::getline(std::cin, sizeInput);
+
+    try {
+        long long sizeMB = std::stoll(sizeInput);
+        return std::max(1LL, std::min(sizeMB, 64LL)) * 1024 * 1024;
+    } catch (...) {
+        return DEFAULT_CHUNK_SIZE;
+    }
+}
+
+SendEngine InteractiveTCPClient::getSendEngine() {
+    std::cout << " 请选择发送引擎 (1=缓冲, 2=sendfile零拷贝) [2]: ";
+    std::string engineInput;
+    std::getline(std::cin, engineInput);
+
+    if (engineInput == "1") {
+        return SendEngine::Buffered;
+    }
+    return SendEngine::ZeroCopy;
+}
+
+CompressionMode InteractiveTCPClient::getCompression() {
+    std::cout << " 请选择压缩 (0=不压缩, 1=快速, 2=高压缩比) [0]: ";
+    std::string compressionInput;
+    std::getline(std::cin, compressionInput);
+
+    if (compressionInput == "1") {
+        return CompressionMode::Fast;
+    }
+    if (compressionInput == "2") {
+        return CompressionMode::High;
+    }
+    return CompressionMode::None;
+}
+
+std::string InteractiveTCPClient::getLocalDirectory() {
+    std::cout << " 请输入保存目录 [.]: ";
+    std::string dirInput;
+    std::getline(std::cin, dirInput);
+    return dirInput.empty() ? "." : dirInput;
+}
+
+SyncMode InteractiveTCPClient::getSyncMode() {
+    std::cout << " 请选择同步方式 (0=全部传输, 1=增量同步, 2=增量同步并删除多余文件) [0]: ";
+    std::string syncInput;
+    std::getline(std::cin, syncInput);
+
+    if (syncInput == "1") {
+        return SyncMode::Incremental;
+    }
+    if (syncInput == "2") {
+        return SyncMode::Mirror;
+    }
+    return SyncMode::Full;
+}
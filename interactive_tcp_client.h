@@ -2,6 +2,7 @@
 #define INTERACTIVE_TCP_CLIENT_H
 
 #include <string>
+#include "transfer_handlers.h"
 
 class InteractiveTCPClient {
 private:
@@ -17,6 +18,11 @@ private:
     void handleUserChoice(const std::string& choice);
     bool validateFilePath(const std::string& path, bool isFile);
     int getThreadCount();
+    long long getChunkSize();
+    SendEngine getSendEngine();
+    CompressionMode getCompression();
+    SyncMode getSyncMode();
+    std::string getLocalDirectory();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "logger.h"
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdarg>
+#include <algorithm>
+
+std::atomic<int> Logger::minimumLevel{static_cast<int>(LogLevel::Info)};
+
+namespace {
+
+const auto WRITER_IDLE_WAIT = std::chrono::milliseconds(50);
+
+struct LogEntry {
+    LogLevel level = LogLevel::Info;
+    bool progress = false;
+    std::string text;
+};
+
+// 有界 MPSC 环形队列: 每个槽的序号表示它当前可写 (等于写入位置) 还是可读 (写入位置 + 1)，
+// 生产者只用一次 CAS 抢占写入位置，消费者只有后台线程一个
+struct Slot {
+    std::atomic<size_t> sequence;
+    LogEntry entry;
+};
+
+struct LoggerState {
+    Slot slots[LOG_RING_CAPACITY];
+    std::atomic<size_t> enqueuePosition{0};
+    size_t dequeuePosition = 0;             // 只由后台线程访问
+    std::atomic<long long> dropped{0};
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable drained;
+    size_t written = 0;                     // 已写出的位置，持锁访问
+
+    std::mutex outputMutex;                 // 后台线程和同步写出互斥，避免一行中间插入另一行
+
+    LoggerState() {
+        for (size_t i = 0; i < LOG_RING_CAPACITY; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+            slots[i].entry.text.reserve(LOG_SLOT_RESERVE);
+        }
+    }
+};
+
+void writeLoop(LoggerState& state);
+
+// 与 BufferPool 一样有意不析构；后台线程在第一条消息时启动，进程退出前由 atexit 写完剩余消息
+LoggerState& loggerState() {
+    static LoggerState* state = [] {
+        LoggerState* created = new LoggerState();
+        std::thread(writeLoop, std::ref(*created)).detach();
+        std::atexit(Logger::flush);
+        return created;
+    }();
+    return *state;
+}
+
+void writeEntry(const LogEntry& entry) {
+    if (entry.progress) {
+        std::cout << entry.text << '\r';
+    } else if (entry.level >= LogLevel::Warn) {
+        std::cerr << entry.text << '\n';
+    } else {
+        std::cout << entry.text << '\n';
+    }
+}
+
+// 文本拷进槽内已有的缓冲区而不是移入，槽的容量一直保留
+bool tryPush(LoggerState& state, LogLevel level, bool progress, const char* text, size_t length) {
+    size_t position = state.enqueuePosition.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &state.slots[position & (LOG_RING_CAPACITY - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0) {
+            if (state.enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = state.enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+    slot->entry.level = level;
+    slot->entry.progress = progress;
+    slot->entry.text.assign(text, length);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+// 直接从槽里写出，写完再把槽交还给生产者
+bool writeNext(LoggerState& state) {
+    Slot& slot = state.slots[state.dequeuePosition & (LOG_RING_CAPACITY - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != state.dequeuePosition + 1) {
+        return false;
+    }
+    if (slot.entry.level >= LogLevel::Warn) {
+        std::cout << std::flush;
+    }
+    writeEntry(slot.entry);
+    slot.sequence.store(state.dequeuePosition + LOG_RING_CAPACITY, std::memory_order_release);
+    state.dequeuePosition++;
+    return true;
+}
+
+void enqueue(LogLevel level, const char* text, size_t length) {
+    LoggerState& state = loggerState();
+    if (tryPush(state, level, false, text, length)) {
+        state.wake.notify_one();
+        return;
+    }
+    if (level >= LogLevel::Warn) {
+        // 队列满时错误不丢弃，直接写出
+        std::lock_guard<std::mutex> output(state.outputMutex);
+        std::cout << std::flush;
+        writeEntry(LogEntry{level, false, std::string(text, length)});
+        std::cerr << std::flush;
+    } else {
+        state.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// 每轮把队列中已有的消息全部写出，最后统一 flush 一次
+void writeLoop(LoggerState& state) {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> output(state.outputMutex);
+            while (writeNext(state)) {
+            }
+            long long dropped = state.dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped > 0) {
+                std::cerr << "\n (日志队列已满，丢弃 " << dropped << " 条消息)" << '\n';
+            }
+            std::cout << std::flush;
+            std::cerr << std::flush;
+        }
+
+        std::unique_lock<std::mutex> lock(state.mutex);
+        state.written = state.dequeuePosition;
+        state.drained.notify_all();
+        state.wake.wait_for(lock, WRITER_IDLE_WAIT);
+    }
+}
+
+} // namespace
+
+void Logger::setLevel(LogLevel level) {
+    minimumLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void Logger::log(LogLevel level, std::string message) {
+    if (!enabled(level)) {
+        return;
+    }
+    enqueue(level, message.data(), message.size());
+}
+
+void Logger::logf(LogLevel level, const char* format, ...) {
+    if (!enabled(level)) {
+        return;
+    }
+    char line[LOG_LINE_LIMIT];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+    enqueue(level, line, std::min(static_cast<size_t>(length), sizeof(line) - 1));
+}
+
+void Logger::progress(std::string line) {
+    if (!enabled(LogLevel::Info)) {
+        return;
+    }
+    LoggerState& state = loggerState();
+    // 进度只需要最新的一条，队列满时直接丢弃，不计入丢弃数
+    if (tryPush(state, LogLevel::Info, true, line.data(), line.size())) {
+        state.wake.notify_one();
+    }
+}
+
+void Logger::flush() {
+    LoggerState& state = loggerState();
+    size_t target = state.enqueuePosition.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.wake.notify_one();
+    state.drained.wait(lock, [&state, target]() { return state.written >= target; });
+}
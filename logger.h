@@ -0,0 +1,66 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <string>
+#include <atomic>
+#include <chrono>
+
+enum class LogLevel {
+    Debug,
+    Info,
+    Warn,       // 警告和错误写到 stderr
+    Error
+};
+
+const size_t LOG_RING_CAPACITY = 8192;      // 必须是 2 的幂
+const size_t LOG_LINE_LIMIT = 512;          // logf 单条消息的上限，超出部分截断
+const size_t LOG_SLOT_RESERVE = 128;        // 每个队列槽预留的文本容量，短消息入队不再分配
+const int PROGRESS_INTERVAL_MS = 200;
+
+// 异步日志: 传输线程把消息放进有界环形队列后立即返回，由后台线程统一写到终端，
+// 发送路径上不再有格式化输出之外的 write() 和 flush。
+// 队列无锁 (多生产者、单消费者)；满时丢弃 Debug/Info 并计数，Warn/Error 改为同步写出，不会丢失。
+// 消息按入队顺序输出。之后要直接写 std::cout 的地方先调用 flush()，保证先后顺序。
+// 入队时把文本拷进槽内预留的缓冲区，热路径用 logf 格式化到栈上，整个过程不分配内存。
+class Logger {
+public:
+    static void setLevel(LogLevel level);
+    static bool enabled(LogLevel level) { return static_cast<int>(level) >= minimumLevel.load(std::memory_order_relaxed); }
+
+    // message 不含换行，输出时自动追加
+    static void log(LogLevel level, std::string message);
+    static void debug(std::string message) { log(LogLevel::Debug, std::move(message)); }
+    static void info(std::string message) { log(LogLevel::Info, std::move(message)); }
+    static void warn(std::string message) { log(LogLevel::Warn, std::move(message)); }
+    static void error(std::string message) { log(LogLevel::Error, std::move(message)); }
+    // printf 风格，级别未启用时不做格式化
+    static void logf(LogLevel level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+    // 进度行: 以 '\r' 结尾，下一条进度覆盖同一行。调用方用 ProgressThrottle 限频
+    static void progress(std::string line);
+
+    // 等待此前入队的消息全部写出
+    static void flush();
+
+private:
+    static std::atomic<int> minimumLevel;
+};
+
+// 进度输出限频: 多个线程共用时也只有一个线程在每个间隔内拿到输出机会
+class ProgressThrottle {
+public:
+    explicit ProgressThrottle(int intervalMs = PROGRESS_INTERVAL_MS) : intervalNanos(intervalMs * 1000000LL) {}
+
+    // 距上次输出已满一个间隔时返回 true
+    bool due() {
+        long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        long long next = nextNanos.load(std::memory_order_relaxed);
+        return now >= next && nextNanos.compare_exchange_strong(next, now + intervalNanos, std::memory_order_relaxed);
+    }
+
+private:
+    long long intervalNanos;
+    std::atomic<long long> nextNanos{0};
+};
+
+#endif
@@ -1,8 +1,24 @@
 #include "interactive_tcp_client.h"
 #include "network_utils.h"
+#include "command_line.h"
 #include <iostream>
 
-int main() {
+int main(int argc, char* argv[]) {
+    CommandLineOptions commandLine;
+    try {
+        if (CommandLine::parse(argc, argv, commandLine)) {
+            if (commandLine.mode == "help") {
+                CommandLine::printUsage(argv[0]);
+                return 0;
+            }
+            return CommandLine::run(commandLine);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << " " << e.what() << std::endl;
+        CommandLine::printUsage(argv[0]);
+        return 2;
+    }
+
     std::cout << "========================================" << std::endl;
     std::cout << "       文件传输客户端" << std::endl;
     std::cout << "========================================" << std::endl;
@@ -24,4 +40,4 @@ int main() {
     }
 
     return 0;
-}
\ No newline at end of file
+}
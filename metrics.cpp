@@ -0,0 +1,358 @@
+#include "metrics.h"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <exception>
+#include <ctime>
+
+std::atomic<bool> Metrics::active{false};
+
+namespace {
+
+// 只由所属线程写入: 读-改-写不需要原子指令，其他线程读取时用 relaxed 读到完整的值
+struct Shard {
+    struct HistogramData {
+        std::atomic<uint64_t> buckets[Metrics::BUCKET_COUNT];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+    HistogramData histograms[HISTOGRAM_COUNT];
+
+    Shard() {
+        for (auto& counter : counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (auto& histogram : histograms) {
+            for (auto& bucket : histogram.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            histogram.count.store(0, std::memory_order_relaxed);
+            histogram.sum.store(0, std::memory_order_relaxed);
+            histogram.max.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+void bump(std::atomic<uint64_t>& value, uint64_t delta) {
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+void raise(std::atomic<uint64_t>& value, uint64_t candidate) {
+    if (candidate > value.load(std::memory_order_relaxed)) {
+        value.store(candidate, std::memory_order_relaxed);
+    }
+}
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<Shard*> live;
+    Shard retired;      // 已退出线程的累计值，只在持锁时访问
+    std::atomic<long long> gauges[GAUGE_COUNT] = {};
+};
+
+// 与 BufferPool 一样有意不析构，线程在静态析构之后退出时仍可并入
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+void merge(Shard& target, const Shard& source) {
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        bump(target.counters[i], source.counters[i].load(std::memory_order_relaxed));
+    }
+    for (int h = 0; h < HISTOGRAM_COUNT; h++) {
+        const Shard::HistogramData& from = source.histograms[h];
+        Shard::HistogramData& to = target.histograms[h];
+        if (from.count.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        for (int b = 0; b < Metrics::BUCKET_COUNT; b++) {
+            bump(to.buckets[b], from.buckets[b].load(std::memory_order_relaxed));
+        }
+        bump(to.count, from.count.load(std::memory_order_relaxed));
+        bump(to.sum, from.sum.load(std::memory_order_relaxed));
+        raise(to.max, from.max.load(std::memory_order_relaxed));
+    }
+}
+
+struct ShardOwner {
+    Shard* shard = nullptr;
+
+    ~ShardOwner() {
+        if (!shard) {
+            return;
+        }
+        Registry& state = registry();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        merge(state.retired, *shard);
+        state.live.erase(std::find(state.live.begin(), state.live.end(), shard));
+        delete shard;
+    }
+};
+
+thread_local ShardOwner localOwner;
+
+// 分片在线程第一次记录时才分配，没有记录过指标的线程 (包括指标关闭时) 不占内存
+Shard& localShard() {
+    if (!localOwner.shard) {
+        Shard* shard = new Shard();
+        Registry& state = registry();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.live.push_back(shard);
+        localOwner.shard = shard;
+    }
+    return *localOwner.shard;
+}
+
+void addTo(Metrics::Snapshot& snapshot, const Shard& shard) {
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        snapshot.counters[i] += shard.counters[i].load(std::memory_order_relaxed);
+    }
+    for (int h = 0; h < HISTOGRAM_COUNT; h++) {
+        const Shard::HistogramData& from = shard.histograms[h];
+        Metrics::HistogramSnapshot& to = snapshot.histograms[h];
+        uint64_t count = from.count.load(std::memory_order_relaxed);
+        if (count == 0) {
+            continue;
+        }
+        for (int b = 0; b < Metrics::BUCKET_COUNT; b++) {
+            to.buckets[b] += from.buckets[b].load(std::memory_order_relaxed);
+        }
+        to.count += count;
+        to.sum += from.sum.load(std::memory_order_relaxed);
+        to.max = std::max(to.max, from.max.load(std::memory_order_relaxed));
+    }
+}
+
+std::string timestamp() {
+    time_t now = time(nullptr);
+    struct tm localTime;
+    localtime_r(&now, &localTime);
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &localTime);
+    return text;
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        if (static_cast<unsigned char>(c) >= 0x20) {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+} // namespace
+
+int Metrics::bucketIndex(uint64_t value) {
+    if (value < static_cast<uint64_t>(SUB_BUCKETS)) {
+        return static_cast<int>(value);
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + static_cast<int>((value >> shift) - SUB_BUCKETS);
+}
+
+uint64_t Metrics::bucketUpperBound(int index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    int shift = index / SUB_BUCKETS - 1;
+    uint64_t lower = static_cast<uint64_t>(index % SUB_BUCKETS + SUB_BUCKETS) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void Metrics::addCounter(Counter counter, uint64_t value) {
+    bump(localShard().counters[static_cast<int>(counter)], value);
+}
+
+void Metrics::recordValue(Histogram histogram, uint64_t value) {
+    Shard::HistogramData& data = localShard().histograms[static_cast<int>(histogram)];
+    bump(data.buckets[bucketIndex(value)], 1);
+    bump(data.count, 1);
+    bump(data.sum, value);
+    raise(data.max, value);
+}
+
+long long Metrics::adjustGauge(Gauge gauge, long long delta) {
+    return registry().gauges[static_cast<int>(gauge)].fetch_add(delta, std::memory_order_relaxed) + delta;
+}
+
+Metrics::Snapshot Metrics::snapshot() {
+    Snapshot snapshot;
+    Registry& state = registry();
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        addTo(snapshot, state.retired);
+        for (const Shard* shard : state.live) {
+            addTo(snapshot, *shard);
+        }
+    }
+    for (int i = 0; i < GAUGE_COUNT; i++) {
+        snapshot.gauges[i] = state.gauges[i].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+uint64_t Metrics::HistogramSnapshot::percentile(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * count + 0.5));
+    uint64_t seen = 0;
+    for (int b = 0; b < BUCKET_COUNT; b++) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            return std::min(bucketUpperBound(b), max);
+        }
+    }
+    return max;
+}
+
+Metrics::Snapshot Metrics::Snapshot::since(const Snapshot& earlier) const {
+    Snapshot delta = *this;
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        delta.counters[i] -= earlier.counters[i];
+    }
+    for (int h = 0; h < HISTOGRAM_COUNT; h++) {
+        HistogramSnapshot& histogram = delta.histograms[h];
+        const HistogramSnapshot& before = earlier.histograms[h];
+        for (int b = 0; b < BUCKET_COUNT; b++) {
+            histogram.buckets[b] -= before.buckets[b];
+        }
+        histogram.count -= before.count;
+        histogram.sum -= before.sum;
+    }
+    return delta;
+}
+
+const char* Metrics::name(Counter counter) {
+    static const char* const names[COUNTER_COUNT] = {
+        "chunks_sent", "chunks_received", "chunk_retries", "files_sent", "connections_opened", "connections_reused"};
+    return names[static_cast<int>(counter)];
+}
+
+const char* Metrics::name(Gauge gauge) {
+    static const char* const names[GAUGE_COUNT] = {"bytes_in_flight", "chunks_in_flight"};
+    return names[static_cast<int>(gauge)];
+}
+
+const char* Metrics::name(Histogram histogram) {
+    static const char* const names[HISTOGRAM_COUNT] = {
+        "chunk_latency_us", "connect_us", "send_bytes", "recv_bytes", "disk_read_us", "disk_write_us",
+        "bytes_in_flight", "read_ahead_depth", "scan_queue_depth"};
+    return names[static_cast<int>(histogram)];
+}
+
+MetricsReporter::MetricsReporter(const std::string& path, int intervalMs)
+    : out(path, std::ios::app), intervalMs(std::max(100, intervalMs)), startTime(std::chrono::steady_clock::now()) {
+    if (!out) {
+        std::cerr << " 无法写入指标文件: " << path << std::endl;
+        return;
+    }
+    Metrics::enable();
+    reporter = std::thread(&MetricsReporter::reportLoop, this);
+}
+
+MetricsReporter::~MetricsReporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    stopRequested.notify_all();
+    if (reporter.joinable()) {
+        reporter.join();
+    }
+}
+
+void MetricsReporter::reportLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        bool stop = stopRequested.wait_for(lock, std::chrono::milliseconds(intervalMs), [this]() { return stopping; });
+        lock.unlock();
+        // 退出前再写一次，最后一个不满间隔的时段也有记录
+        writeLine("\"type\":\"interval\"", Metrics::snapshot());
+        lock.lock();
+        if (stop) {
+            return;
+        }
+    }
+}
+
+void MetricsReporter::writeSession(const std::string& label, const Metrics::Snapshot& delta, bool ok, double wallMs) {
+    std::ostringstream header;
+    header << std::fixed << std::setprecision(3)
+           << "\"type\":\"session\",\"label\":\"" << jsonEscape(label) << "\""
+           << ",\"status\":\"" << (ok ? "ok" : "failed") << "\",\"wall_ms\":" << wallMs;
+    writeLine(header.str(), delta);
+}
+
+void MetricsReporter::writeLine(const std::string& header, const Metrics::Snapshot& snapshot) {
+    if (!out) {
+        return;
+    }
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1)
+         << "{\"time\":\"" << timestamp() << "\",\"elapsed_ms\":"
+         << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count()
+         << "," << header;
+
+    line << ",\"counters\":{";
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        line << (i ? "," : "") << "\"" << Metrics::name(static_cast<Counter>(i)) << "\":" << snapshot.counters[i];
+    }
+    line << "},\"gauges\":{";
+    for (int i = 0; i < GAUGE_COUNT; i++) {
+        line << (i ? "," : "") << "\"" << Metrics::name(static_cast<Gauge>(i)) << "\":" << snapshot.gauges[i];
+    }
+
+    // 没有样本的直方图不输出
+    line << "},\"histograms\":{";
+    bool first = true;
+    for (int h = 0; h < HISTOGRAM_COUNT; h++) {
+        const Metrics::HistogramSnapshot& histogram = snapshot.histograms[h];
+        if (histogram.count == 0) {
+            continue;
+        }
+        line << (first ? "" : ",") << "\"" << Metrics::name(static_cast<Histogram>(h)) << "\":{"
+             << "\"count\":" << histogram.count
+             << ",\"sum\":" << histogram.sum
+             << ",\"mean\":" << histogram.mean()
+             << ",\"p50\":" << histogram.percentile(0.5)
+             << ",\"p90\":" << histogram.percentile(0.9)
+             << ",\"p99\":" << histogram.percentile(0.99)
+             << ",\"p999\":" << histogram.percentile(0.999)
+             << ",\"max\":" << histogram.max << "}";
+        first = false;
+    }
+    line << "}}";
+
+    std::lock_guard<std::mutex> lock(mutex);
+    out << line.str() << std::endl;
+}
+
+MetricsSession::MetricsSession(MetricsReporter* reporter, const std::string& label)
+    : reporter(reporter), label(label), exceptionsAtStart(std::uncaught_exceptions()),
+      startTime(std::chrono::steady_clock::now()) {
+    if (reporter) {
+        start = Metrics::snapshot();
+    }
+}
+
+MetricsSession::~MetricsSession() {
+    if (!reporter) {
+        return;
+    }
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    reporter->writeSession(label, Metrics::snapshot().since(start), std::uncaught_exceptions() == exceptionsAtStart,
+                           wallMs);
+}
@@ -0,0 +1,184 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+enum class Counter {
+    ChunksSent,
+    ChunksReceived,
+    ChunkRetries,
+    FilesSent,
+    ConnectionsOpened,
+    ConnectionsReused,
+    Count
+};
+
+enum class Gauge {
+    BytesInFlight,      // 已发出、服务器尚未确认的块数据
+    ChunksInFlight,
+    Count
+};
+
+enum class Histogram {
+    ChunkLatencyUs,     // 上传块从取连接到收到确认，下载块从请求到收完
+    ConnectUs,          // 新建 TCP 连接
+    SendBytes,          // 每次 send()/sendfile() 实际发送的字节数
+    RecvBytes,          // 每次 recv() 实际收到的字节数
+    DiskReadUs,         // 每次 pread()
+    DiskWriteUs,        // 每次 pwrite()
+    BytesInFlight,      // 每次发送后的未确认字节数
+    ReadAheadDepth,     // 发送方取数据时预读流水线中已就绪的槽数
+    ScanQueueDepth,     // 文件夹发送流取一批时扫描队列中的项数
+    Count
+};
+
+const int COUNTER_COUNT = static_cast<int>(Counter::Count);
+const int GAUGE_COUNT = static_cast<int>(Gauge::Count);
+const int HISTOGRAM_COUNT = static_cast<int>(Histogram::Count);
+
+// 进程内的传输指标: 计数器、当前值 (gauge) 和对数分桶直方图。
+// 计数器和直方图按线程分片，记录时只写本线程的分片 (不加锁，没有跨线程共享的缓存行)，
+// 读取时把所有分片相加，线程退出时分片并入累计值。
+// 直方图每个 2 的幂区间再等分 16 桶 (HDR 风格)，任意取值的相对误差不超过 1/16。
+// 默认关闭，关闭时每个记录点只有一次原子读。
+class Metrics {
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    struct HistogramSnapshot {
+        std::vector<uint64_t> buckets = std::vector<uint64_t>(BUCKET_COUNT, 0);
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        // 返回所在桶的上界，不超过实际最大值
+        uint64_t percentile(double fraction) const;
+        double mean() const { return count ? static_cast<double>(sum) / count : 0; }
+    };
+
+    struct Snapshot {
+        uint64_t counters[COUNTER_COUNT] = {};
+        long long gauges[GAUGE_COUNT] = {};
+        HistogramSnapshot histograms[HISTOGRAM_COUNT];
+
+        // 与较早快照的差值，用于单次传输的统计；gauge 和 max 取当前值
+        Snapshot since(const Snapshot& earlier) const;
+    };
+
+    static void enable() { active.store(true, std::memory_order_relaxed); }
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+    static void add(Counter counter, uint64_t value = 1) {
+        if (enabled()) {
+            addCounter(counter, value);
+        }
+    }
+    static void record(Histogram histogram, uint64_t value) {
+        if (enabled()) {
+            recordValue(histogram, value);
+        }
+    }
+    // 返回调整后的值，关闭时返回 0
+    static long long adjust(Gauge gauge, long long delta) {
+        return enabled() ? adjustGauge(gauge, delta) : 0;
+    }
+
+    static Snapshot snapshot();
+
+    static const char* name(Counter counter);
+    static const char* name(Gauge gauge);
+    static const char* name(Histogram histogram);
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(int index);
+
+private:
+    static void addCounter(Counter counter, uint64_t value);
+    static void recordValue(Histogram histogram, uint64_t value);
+    static long long adjustGauge(Gauge gauge, long long delta);
+
+    static std::atomic<bool> active;
+};
+
+// 记录一段耗时 (微秒)，指标关闭时不读时钟。
+// 只有调用 stop() 才记录，出错路径上直接离开作用域的不计入
+class MetricsTimer {
+public:
+    explicit MetricsTimer(Histogram histogram) : histogram(histogram), running(Metrics::enabled()) {
+        if (running) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    MetricsTimer(const MetricsTimer&) = delete;
+    MetricsTimer& operator=(const MetricsTimer&) = delete;
+
+    void stop() {
+        if (running) {
+            running = false;
+            Metrics::record(histogram, std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count());
+        }
+    }
+
+private:
+    Histogram histogram;
+    bool running;
+    std::chrono::steady_clock::time_point start;
+};
+
+const int DEFAULT_METRICS_INTERVAL_MS = 1000;
+
+// 按固定间隔把累计指标追加写入文件，每行一个 JSON 对象 ("type":"interval")；
+// 每次传输结束时另写一行该次传输期间的差值 ("type":"session")。
+class MetricsReporter {
+public:
+    MetricsReporter(const std::string& path, int intervalMs = DEFAULT_METRICS_INTERVAL_MS);
+    ~MetricsReporter();
+
+    MetricsReporter(const MetricsReporter&) = delete;
+    MetricsReporter& operator=(const MetricsReporter&) = delete;
+
+    void writeSession(const std::string& label, const Metrics::Snapshot& delta, bool ok, double wallMs);
+
+private:
+    void reportLoop();
+    void writeLine(const std::string& header, const Metrics::Snapshot& snapshot);
+
+    std::ofstream out;
+    int intervalMs;
+    std::chrono::steady_clock::time_point startTime;
+
+    std::mutex mutex;
+    std::condition_variable stopRequested;
+    bool stopping = false;
+    std::thread reporter;
+};
+
+// 一次传输的指标区间: 析构时把开始以来的差值交给 reporter，传输以异常结束时记为失败
+class MetricsSession {
+public:
+    MetricsSession(MetricsReporter* reporter, const std::string& label);
+    ~MetricsSession();
+
+    MetricsSession(const MetricsSession&) = delete;
+    MetricsSession& operator=(const MetricsSession&) = delete;
+
+private:
+    MetricsReporter* reporter;
+    std::string label;
+    int exceptionsAtStart;
+    Metrics::Snapshot start;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+#endif
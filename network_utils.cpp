@@ -1,4 +1,8 @@
 #include "network_utils.h"
+#include "wire_protocol.h"
+#include "buffer_pool.h"
+#include "connection_pool.h"
+#include "metrics.h"
 #include "../common/constants.h"
 #include <iostream>
 #include <unistd.h>
@@ -6,11 +10,17 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <ctime>
 #include <sys/time.h>
 #include <ifaddrs.h>
 #include <cstring>
 #include <iomanip>
+#include <cerrno>
+#include <vector>
+#include <algorithm>
+#include <sys/sendfile.h>
+#include <sys/resource.h>
 
 int NetworkUtils::createConnection(const std::string& serverIP, int serverPort) {
     int sock = socket(AF_INET, SOCK_STREAM, 0);
@@ -43,6 +53,38 @@ int NetworkUtils::createConnection(const std::string& serverIP, int serverPort)
     return sock;
 }
 
+int NetworkUtils::negotiateProtocol(const std::string& serverIP, int serverPort, uint32_t& capabilities) {
+    capabilities = 0;
+
+    int sock;
+    try {
+        sock = ConnectionPool::acquire(serverIP, serverPort);
+    } catch (...) {
+        return 1;
+    }
+
+    // Hello 帧恰好 16 字节且末 4 字节为 0: 旧服务器会把它当成块头，
+    // 因块大小为 0 直接断开连接，此时回退到 v1
+    WireMessage hello(FrameType::Hello);
+    hello.put(static_cast<uint32_t>(0));
+
+    int version = 1;
+    std::vector<char> payload;
+    if (hello.sendAll(sock) && WireReader::recvFrame(sock, FrameType::HelloAck, payload)) {
+        WireReader reader(payload);
+        uint16_t serverVersion = reader.get<uint16_t>();
+        uint32_t serverCapabilities = reader.get<uint32_t>();
+        if (reader.ok() && serverVersion >= PROTOCOL_VERSION) {
+            version = PROTOCOL_VERSION;
+            capabilities = serverCapabilities;
+        }
+    }
+
+    // 支持保持连接时握手用过的连接留给第一个请求
+    ConnectionPool::release(sock, serverIP, serverPort, version >= 2 && (capabilities & CAPABILITY_KEEPALIVE));
+    return version;
+}
+
 bool NetworkUtils::discoverServer(std::string& discoveredIP, int& discoveredPort) {
     std::cout << " 正在搜索服务器..." << std::endl;
 
@@ -146,6 +188,22 @@ FileAttributes NetworkUtils::getFileAttributes(const std::string& filePath) {
         throw std::runtime_error("Failed to get file attributes for: " + filePath);
     }
 
+    return attributesFromStat(fileStat);
+}
+
+bool NetworkUtils::applyFileAttributes(const std::string& filePath, const FileAttributes& attrs) {
+    bool success = chmod(filePath.c_str(), attrs.permissions & 07777) == 0;
+
+    struct timespec times[2];
+    times[0] = attrs.access_time;
+    times[1] = attrs.modify_time;
+    if (utimensat(AT_FDCWD, filePath.c_str(), times, 0) != 0) {
+        success = false;
+    }
+    return success;
+}
+
+FileAttributes NetworkUtils::attributesFromStat(const struct stat& fileStat) {
     FileAttributes attrs;
     attrs.permissions = fileStat.st_mode;
     
@@ -196,4 +254,65 @@ void NetworkUtils::displayFileAttributes(const std::string& filePath, const File
     std::cout << "修改: " << timeBuf << "." << std::setw(9) << std::setfill('0') 
               << attrs.modify_time.tv_nsec << std::setfill(' ') << std::endl;
     std::cout << "========================\n" << std::endl;
+}
+
+long long NetworkUtils::sendFileRange(int socket, int fd, long long offset, long long count, bool& zeroCopy) {
+    long long sent = 0;
+
+    while (zeroCopy && sent < count) {
+        off_t pos = offset + sent;
+        ssize_t result = sendfile(socket, fd, &pos, count - sent);
+        if (result > 0) {
+            Metrics::record(Histogram::SendBytes, result);
+            sent += result;
+            continue;
+        }
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0 && sent == 0 && (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+            // 文件系统或套接字不支持 sendfile，回退到缓冲发送
+            zeroCopy = false;
+            break;
+        }
+        return -1;
+    }
+
+    if (sent >= count) {
+        return sent;
+    }
+
+    PooledBuffer buffer = BufferPool::acquire(BUFFER_SIZE);
+    while (sent < count) {
+        size_t toRead = std::min(static_cast<long long>(BUFFER_SIZE), count - sent);
+        ssize_t bytesRead = pread(fd, buffer.data(), toRead, offset + sent);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            return -1;
+        }
+
+        ssize_t bytesSent = 0;
+        while (bytesSent < bytesRead) {
+            ssize_t result = send(socket, buffer.data() + bytesSent, bytesRead - bytesSent, 0);
+            if (result <= 0) {
+                return -1;
+            }
+            Metrics::record(Histogram::SendBytes, result);
+            bytesSent += result;
+        }
+        sent += bytesRead;
+    }
+
+    return sent;
+}
+
+double NetworkUtils::processCpuSeconds() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
 }
\ No newline at end of file
@@ -2,15 +2,22 @@
 #define NETWORK_UTILS_H
 
 #include <string>
+#include <cstdint>
 #include "../common/file_attributes.h"
 
 class NetworkUtils {
 public:
     static int createConnection(const std::string& serverIP, int serverPort);
     static bool discoverServer(std::string& discoveredIP, int& discoveredPort);
+    static int negotiateProtocol(const std::string& serverIP, int serverPort, uint32_t& capabilities);
     static FileAttributes getFileAttributes(const std::string& filePath);
+    static FileAttributes attributesFromStat(const struct stat& fileStat);
+    // 下载完成后恢复权限和时间戳；客户端通常无权 chown，所有者不恢复
+    static bool applyFileAttributes(const std::string& filePath, const FileAttributes& attrs);
     static void displayFileAttributes(const std::string& filePath, 
                                    const FileAttributes& attrs, long fileSize);
+    static long long sendFileRange(int socket, int fd, long long offset, long long count, bool& zeroCopy);
+    static double processCpuSeconds();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "read_pipeline.h"
+#include "metrics.h"
+#include "trace.h"
+#include "alloc_counter.h"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+ReadAheadPipeline::ReadAheadPipeline(int depth, size_t slotSize)
+    : slotSize(slotSize), slots(std::max(2, depth)) {
+    for (auto& slot : slots) {
+        slot.buffer = BufferPool::acquire(slotSize);
+    }
+    reader = std::thread(&ReadAheadPipeline::readLoop, this);
+}
+
+ReadAheadPipeline::ReadAheadPipeline(int fd, long long offset, long long length, int depth, size_t slotSize)
+    : ReadAheadPipeline(depth, slotSize) {
+    singleRange = {offset, length};
+    startRanges(fd, &singleRange, 1);
+}
+
+ReadAheadPipeline::ReadAheadPipeline(int fd, const std::vector<FileExtent>& ranges, int depth, size_t slotSize)
+    : ReadAheadPipeline(depth, slotSize) {
+    start(fd, ranges);
+}
+
+ReadAheadPipeline::~ReadAheadPipeline() {
+    finish();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutdown = true;
+    }
+    roundChanged.notify_all();
+    reader.join();
+}
+
+void ReadAheadPipeline::start(int fd, const std::vector<FileExtent>& ranges) {
+    startRanges(fd, ranges.data(), ranges.size());
+}
+
+void ReadAheadPipeline::startRanges(int fd, const FileExtent* first, size_t count) {
+    finish();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->fd = fd;
+        ranges = first;
+        rangeCount = count;
+        filled = 0;
+        consumed = 0;
+        holding = false;
+        finished = false;
+        error = false;
+        stopping = false;
+        senderWaitNanos = 0;
+        readerWaitNanos = 0;
+        roundAllocations = 0;
+        reading = true;
+    }
+    roundChanged.notify_all();
+}
+
+void ReadAheadPipeline::finish() {
+    std::unique_lock<std::mutex> lock(mutex);
+    stopping = true;
+    slotFreed.notify_all();
+    roundChanged.wait(lock, [this]() { return !reading; });
+}
+
+// 读线程常驻: 每轮读完 (或被 finish 打断) 后回到空闲状态等待下一轮
+void ReadAheadPipeline::readLoop() {
+    Trace::nameThread("read-ahead");
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        roundChanged.wait(lock, [this]() { return reading || shutdown; });
+        if (shutdown) {
+            return;
+        }
+        lock.unlock();
+
+        long long allocationsBefore = AllocationCounter::threadCount();
+        bool completed = true;
+        for (size_t i = 0; i < rangeCount && completed; i++) {
+            completed = readRange(ranges[i].offset, ranges[i].length);
+        }
+
+        lock.lock();
+        if (completed) {
+            finished = true;
+        }
+        roundAllocations = AllocationCounter::threadCount() - allocationsBefore;
+        reading = false;
+        slotFilled.notify_one();
+        roundChanged.notify_all();
+    }
+}
+
+bool ReadAheadPipeline::readRange(long long offset, long long length) {
+    posix_fadvise(fd, offset, length, POSIX_FADV_SEQUENTIAL);
+
+    long long pos = offset;
+    long long end = offset + length;
+    while (pos < end) {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto waitStart = std::chrono::steady_clock::now();
+            slotFreed.wait(lock, [this]() { return stopping || filled - consumed < slots.size(); });
+            readerWaitNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - waitStart).count();
+            if (stopping) {
+                return false;
+            }
+            index = filled % slots.size();
+        }
+
+        // 提示内核预读当前槽之后的一整圈
+        long long toRead = std::min(static_cast<long long>(slotSize), end - pos);
+        if (pos + toRead < end) {
+            posix_fadvise(fd, pos + toRead, std::min(static_cast<long long>(slotSize * slots.size()), end - pos - toRead),
+                          POSIX_FADV_WILLNEED);
+        }
+
+        char* buffer = slots[index].buffer.data();
+        long long done = 0;
+        bool readError = false;
+        TraceSpan readSpan("disk", "disk_read");
+        readSpan.arg("offset", pos);
+        readSpan.arg("bytes", toRead);
+        while (done < toRead) {
+            MetricsTimer readTimer(Histogram::DiskReadUs);
+            ssize_t result = pread(fd, buffer + done, toRead - done, pos + done);
+            readTimer.stop();
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                readError = true;
+                break;
+            }
+            done += result;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (readError) {
+                error = true;
+                finished = true;
+                slotFilled.notify_one();
+                return false;
+            }
+            slots[index].length = done;
+            slots[index].fileOffset = pos;
+            filled++;
+        }
+        slotFilled.notify_one();
+        pos += done;
+    }
+    return true;
+}
+
+bool ReadAheadPipeline::next(const char*& data, size_t& dataLength, long long* fileOffset) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (holding) {
+        consumed++;
+        holding = false;
+        slotFreed.notify_one();
+    }
+
+    auto waitStart = std::chrono::steady_clock::now();
+    slotFilled.wait(lock, [this]() { return filled > consumed || finished; });
+    senderWaitNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - waitStart).count();
+
+    if (filled > consumed) {
+        Metrics::record(Histogram::ReadAheadDepth, filled - consumed);
+        const Slot& slot = slots[consumed % slots.size()];
+        data = slot.buffer.data();
+        dataLength = slot.length;
+        if (fileOffset) {
+            *fileOffset = slot.fileOffset;
+        }
+        holding = true;
+        return true;
+    }
+    return false;
+}
+
+bool ReadAheadPipeline::failed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return error;
+}
@@ -0,0 +1,108 @@
+#ifndef READ_PIPELINE_H
+#define READ_PIPELINE_H
+
+#include <cstddef>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "buffer_pool.h"
+#include "sparse_file.h"
+
+const int READ_AHEAD_DEPTH = 4;
+const size_t READ_AHEAD_SLOT_SIZE = 256 * 1024;
+
+// 预读流水线: 读线程按顺序把文件区间读进一圈缓冲槽，发送方依次取走。
+// 磁盘读和 send() 互相重叠，吞吐接近 min(磁盘, 网络) 而不是两者的调和平均。
+// 读线程和缓冲槽可以跨多轮复用 (start/finish)，分块发送时每个发送线程只创建一次。
+class ReadAheadPipeline {
+public:
+    // 空闲的流水线，之后用 start() 开始一轮读取
+    explicit ReadAheadPipeline(int depth = READ_AHEAD_DEPTH, size_t slotSize = READ_AHEAD_SLOT_SIZE);
+    ReadAheadPipeline(int fd, long long offset, long long length,
+                      int depth = READ_AHEAD_DEPTH, size_t slotSize = READ_AHEAD_SLOT_SIZE);
+    // 依次读取多个区间，用于稀疏文件只读数据区。ranges 须在流水线读完前保持有效
+    ReadAheadPipeline(int fd, const std::vector<FileExtent>& ranges,
+                      int depth = READ_AHEAD_DEPTH, size_t slotSize = READ_AHEAD_SLOT_SIZE);
+    ~ReadAheadPipeline();
+
+    ReadAheadPipeline(const ReadAheadPipeline&) = delete;
+    ReadAheadPipeline& operator=(const ReadAheadPipeline&) = delete;
+
+    // 开始新一轮读取，未结束的上一轮先被结束。ranges 须在本轮结束前保持有效
+    void start(int fd, const std::vector<FileExtent>& ranges);
+    // 让读线程停下并等它回到空闲状态，之后才能关闭 fd
+    void finish();
+
+    // 取下一段数据，同时归还上一次取到的槽。读完或读出错时返回 false
+    bool next(const char*& data, size_t& length, long long* fileOffset = nullptr);
+    bool failed() const;
+
+    // 发送方等待磁盘、读线程等待发送方的累计时间 (本轮)，用于判断瓶颈在哪一侧
+    long long diskWaitNanos() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return senderWaitNanos;
+    }
+    long long networkWaitNanos() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return readerWaitNanos;
+    }
+    // 读线程在最近一轮中的堆分配次数，见 AllocationCounter
+    long long readerAllocations() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return roundAllocations;
+    }
+
+private:
+    struct Slot {
+        PooledBuffer buffer;
+        size_t length = 0;
+        long long fileOffset = 0;
+    };
+
+    void startRanges(int fd, const FileExtent* first, size_t count);
+    void readLoop();
+    bool readRange(long long offset, long long length);
+
+    int fd = -1;
+    const FileExtent* ranges = nullptr;
+    size_t rangeCount = 0;
+    FileExtent singleRange{0, 0};
+    size_t slotSize;
+    std::vector<Slot> slots;
+
+    mutable std::mutex mutex;
+    std::condition_variable slotFilled;
+    std::condition_variable slotFreed;
+    std::condition_variable roundChanged;
+    bool reading = false;    // 读线程正在处理一轮读取
+    bool shutdown = false;
+    size_t filled = 0;       // 读线程已填充的槽总数
+    size_t consumed = 0;     // 发送方已归还的槽总数
+    bool holding = false;    // 发送方手上是否有一个尚未归还的槽
+    bool finished = false;
+    bool error = false;
+    bool stopping = false;
+    long long senderWaitNanos = 0;
+    long long readerWaitNanos = 0;
+    long long roundAllocations = 0;
+
+    std::thread reader;
+};
+
+// 在复用的流水线上读一轮，离开作用域时结束本轮: 异常路径上也先停下读线程，再关闭 fd
+class ReadAheadRound {
+public:
+    ReadAheadRound(ReadAheadPipeline& pipeline, int fd, const std::vector<FileExtent>& ranges) : pipeline(pipeline) {
+        pipeline.start(fd, ranges);
+    }
+    ~ReadAheadRound() { pipeline.finish(); }
+
+    ReadAheadRound(const ReadAheadRound&) = delete;
+    ReadAheadRound& operator=(const ReadAheadRound&) = delete;
+
+private:
+    ReadAheadPipeline& pipeline;
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "resume_journal.h"
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+ResumeJournal::ResumeJournal() : fd(-1), pendingRecords(0) {}
+
+ResumeJournal::~ResumeJournal() {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if (fd >= 0) {
+        syncLocked();
+        close(fd);
+    }
+}
+
+bool ResumeJournal::open(const std::string& transferKey, int totalChunks) {
+    std::lock_guard<std::mutex> lock(journalMutex);
+
+    if (mkdir(JOURNAL_DIRECTORY, 0755) != 0 && errno != EEXIST) {
+        return false;
+    }
+
+    // FNV-1a 散列出日志文件名，完整标识写在首行用于校验
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : transferKey) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    std::ostringstream name;
+    name << JOURNAL_DIRECTORY << "/" << std::hex << hash << ".journal";
+    journalPath = name.str();
+
+    std::ostringstream headerLine;
+    headerLine << "FTJ1 " << totalChunks << " " << transferKey;
+    header = headerLine.str();
+    done.assign(totalChunks, false);
+
+    // 回放已有记录；首行不匹配说明是另一次传输，直接重建
+    bool matched = false;
+    std::ifstream existing(journalPath);
+    std::string line;
+    if (existing.is_open() && std::getline(existing, line) && line == header) {
+        matched = true;
+        while (std::getline(existing, line)) {
+            if (existing.eof()) {
+                break;  // 末行没有换行符，说明写到一半就崩溃了
+            }
+            char* end = nullptr;
+            long index = std::strtol(line.c_str(), &end, 10);
+            if (end != line.c_str() && *end == '\0' && index >= 0 && index < totalChunks) {
+                done[index] = true;
+            }
+        }
+    }
+    existing.close();
+
+    int flags = O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC;
+    if (!matched) {
+        flags |= O_TRUNC;
+    }
+    fd = ::open(journalPath.c_str(), flags, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    if (!matched) {
+        appendLocked(header + "\n");
+        syncLocked();
+    }
+    lastSync = std::chrono::steady_clock::now();
+    return true;
+}
+
+void ResumeJournal::track(int totalChunks) {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    done.assign(totalChunks, false);
+}
+
+void ResumeJournal::reset() {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    done.assign(done.size(), false);
+    if (fd >= 0 && ftruncate(fd, 0) == 0) {
+        appendLocked(header + "\n");
+        syncLocked();
+    }
+}
+
+bool ResumeJournal::isDone(int chunkIndex) const {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    return chunkIndex >= 0 && chunkIndex < static_cast<int>(done.size()) && done[chunkIndex];
+}
+
+void ResumeJournal::markDone(int chunkIndex) {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if (chunkIndex < 0 || chunkIndex >= static_cast<int>(done.size()) || done[chunkIndex]) {
+        return;
+    }
+    done[chunkIndex] = true;
+    appendLocked(std::to_string(chunkIndex) + "\n");
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - lastSync).count();
+    if (++pendingRecords >= JOURNAL_FSYNC_BATCH || elapsed >= JOURNAL_FSYNC_INTERVAL_MS) {
+        syncLocked();
+    }
+}
+
+void ResumeJournal::sync() {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    syncLocked();
+}
+
+void ResumeJournal::remove() {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    if (!journalPath.empty()) {
+        unlink(journalPath.c_str());
+    }
+    pendingRecords = 0;
+}
+
+int ResumeJournal::completedCount() const {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    int count = 0;
+    for (bool chunkDone : done) {
+        count += chunkDone ? 1 : 0;
+    }
+    return count;
+}
+
+std::vector<uint8_t> ResumeJournal::bitmap() const {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    std::vector<uint8_t> bits((done.size() + 7) / 8, 0);
+    for (size_t i = 0; i < done.size(); i++) {
+        if (done[i]) {
+            bits[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+        }
+    }
+    return bits;
+}
+
+void ResumeJournal::assignBitmap(const std::vector<uint8_t>& bits) {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if (fd >= 0 && ftruncate(fd, 0) == 0) {
+        appendLocked(header + "\n");
+    }
+    for (size_t i = 0; i < done.size(); i++) {
+        done[i] = i / 8 < bits.size() && (bits[i / 8] & (1 << (i % 8)));
+        if (done[i]) {
+            appendLocked(std::to_string(i) + "\n");
+        }
+    }
+    syncLocked();
+}
+
+void ResumeJournal::appendLocked(const std::string& line) {
+    if (fd < 0) {
+        return;
+    }
+    size_t written = 0;
+    while (written < line.size()) {
+        ssize_t result = write(fd, line.data() + written, line.size() - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return;
+        }
+        written += result;
+    }
+}
+
+void ResumeJournal::syncLocked() {
+    if (fd >= 0) {
+        fdatasync(fd);
+    }
+    pendingRecords = 0;
+    lastSync = std::chrono::steady_clock::now();
+}
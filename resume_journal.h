@@ -0,0 +1,51 @@
+#ifndef RESUME_JOURNAL_H
+#define RESUME_JOURNAL_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+const char* const JOURNAL_DIRECTORY = ".file_transfer_journal";
+const int JOURNAL_FSYNC_BATCH = 8;          // 累计多少条记录后 fsync
+const int JOURNAL_FSYNC_INTERVAL_MS = 1000; // 或距上次 fsync 超过该时间
+
+// 分块传输的断点日志。每个传输 (服务器、目标名、大小、修改时间、块大小) 对应一个
+// 追加写的日志文件: 首行是传输标识，其后每行一个已确认的块号。
+// 崩溃时最多丢失最后一批未 fsync 的记录，这些块会被重新发送。
+class ResumeJournal {
+public:
+    ResumeJournal();
+    ~ResumeJournal();
+
+    ResumeJournal(const ResumeJournal&) = delete;
+    ResumeJournal& operator=(const ResumeJournal&) = delete;
+
+    bool open(const std::string& transferKey, int totalChunks);
+    // 只在内存中记录，不写日志文件，用于不支持续传的服务器
+    void track(int totalChunks);
+    void reset();
+    bool isDone(int chunkIndex) const;
+    void markDone(int chunkIndex);
+    void sync();
+    void remove();
+
+    int completedCount() const;
+    std::vector<uint8_t> bitmap() const;
+    void assignBitmap(const std::vector<uint8_t>& bits);
+
+private:
+    void appendLocked(const std::string& line);
+    void syncLocked();
+
+    mutable std::mutex journalMutex;
+    std::string journalPath;
+    std::string header;
+    int fd;
+    std::vector<bool> done;
+    int pendingRecords;
+    std::chrono::steady_clock::time_point lastSync;
+};
+
+#endif
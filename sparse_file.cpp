@@ -0,0 +1,101 @@
+#include "sparse_file.h"
+#include "wire_protocol.h"
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+
+// ExtentMap 帧载荷: 个数(4) + 每项偏移(8) + 长度(8)
+const size_t MAX_EXTENTS_PER_MAP = (MAX_FRAME_PAYLOAD - 4) / 16;
+
+bool SparseFile::isSparse(const struct stat& fileStat) {
+    return S_ISREG(fileStat.st_mode) && static_cast<long long>(fileStat.st_blocks) * 512 < fileStat.st_size;
+}
+
+std::vector<FileExtent> SparseFile::dataExtents(int fd, long long offset, long long length) {
+    std::vector<FileExtent> extents;
+    dataExtents(fd, offset, length, extents);
+    return extents;
+}
+
+void SparseFile::dataExtents(int fd, long long offset, long long length, std::vector<FileExtent>& extents) {
+    extents.clear();
+    long long end = offset + length;
+    long long pos = offset;
+
+    while (pos < end) {
+        off_t dataStart = lseek(fd, pos, SEEK_DATA);
+        if (dataStart < 0) {
+            if (errno == ENXIO) {
+                break;  // pos 之后全是空洞
+            }
+            // 不支持 SEEK_DATA，按一个完整数据区处理
+            extents.assign(1, {offset, length});
+            return;
+        }
+        if (dataStart >= end) {
+            break;
+        }
+        off_t holeStart = lseek(fd, dataStart, SEEK_HOLE);
+        if (holeStart < 0) {
+            holeStart = end;
+        }
+        long long extentEnd = std::min(static_cast<long long>(holeStart), end);
+        extents.push_back({dataStart, extentEnd - dataStart});
+        pos = extentEnd;
+    }
+
+    limitExtents(extents, MAX_EXTENTS_PER_MAP);
+}
+
+void SparseFile::limitExtents(std::vector<FileExtent>& extents, size_t maxCount) {
+    if (extents.size() <= maxCount || maxCount == 0) {
+        return;
+    }
+
+    // 找出需要合并的最小间隔阈值，然后一次扫描完成合并
+    std::vector<long long> gaps;
+    for (size_t i = 1; i < extents.size(); i++) {
+        gaps.push_back(extents[i].offset - (extents[i - 1].offset + extents[i - 1].length));
+    }
+    size_t mergeCount = extents.size() - maxCount;
+    std::vector<long long> sorted = gaps;
+    std::nth_element(sorted.begin(), sorted.begin() + (mergeCount - 1), sorted.end());
+    long long threshold = sorted[mergeCount - 1];
+    size_t belowThreshold = std::count_if(gaps.begin(), gaps.end(), [threshold](long long gap) { return gap < threshold; });
+    size_t equalBudget = mergeCount - belowThreshold;
+
+    std::vector<FileExtent> merged;
+    merged.push_back(extents[0]);
+    for (size_t i = 1; i < extents.size(); i++) {
+        bool merge = gaps[i - 1] < threshold;
+        if (!merge && gaps[i - 1] == threshold && equalBudget > 0) {
+            merge = true;
+            equalBudget--;
+        }
+        if (merge) {
+            merged.back().length = extents[i].offset + extents[i].length - merged.back().offset;
+        } else {
+            merged.push_back(extents[i]);
+        }
+    }
+    extents.swap(merged);
+}
+
+long long SparseFile::dataBytes(const std::vector<FileExtent>& extents) {
+    long long total = 0;
+    for (const auto& extent : extents) {
+        total += extent.length;
+    }
+    return total;
+}
+
+bool SparseFile::sendExtentMap(int socket, const std::vector<FileExtent>& extents) {
+    thread_local WireMessage map;
+    map.reset(FrameType::ExtentMap);
+    map.put(static_cast<uint32_t>(extents.size()));
+    for (const auto& extent : extents) {
+        map.put(static_cast<uint64_t>(extent.offset));
+        map.put(static_cast<uint64_t>(extent.length));
+    }
+    return map.sendAll(socket);
+}
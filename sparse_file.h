@@ -0,0 +1,30 @@
+#ifndef SPARSE_FILE_H
+#define SPARSE_FILE_H
+
+#include <vector>
+#include <cstddef>
+#include <sys/stat.h>
+
+struct FileExtent {
+    long long offset;
+    long long length;
+};
+
+// 稀疏文件支持: 用 lseek(SEEK_DATA/SEEK_HOLE) 找出数据区，空洞不读不发。
+// v2 下稀疏文件的头之后跟一个 ExtentMap 帧，其后按顺序只发送各数据区的内容；
+// 接收端 ftruncate 到原大小后只写数据区，空洞保持未分配。
+class SparseFile {
+public:
+    // 实际分配的块少于文件大小才值得枚举数据区
+    static bool isSparse(const struct stat& fileStat);
+    // 列出 [offset, offset + length) 内的数据区；文件系统不支持时返回整个区间
+    static std::vector<FileExtent> dataExtents(int fd, long long offset, long long length);
+    // 同上，结果写入 extents，复用调用方已有的容量
+    static void dataExtents(int fd, long long offset, long long length, std::vector<FileExtent>& extents);
+    // 合并间隔最小的相邻数据区，使数量不超过 maxCount (被合并的空洞按零发送)
+    static void limitExtents(std::vector<FileExtent>& extents, size_t maxCount);
+    static long long dataBytes(const std::vector<FileExtent>& extents);
+    static bool sendExtentMap(int socket, const std::vector<FileExtent>& extents);
+};
+
+#endif
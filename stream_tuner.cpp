@@ -0,0 +1,143 @@
+#include "stream_tuner.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <sys/time.h>
+
+namespace {
+
+std::string timestamp() {
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    struct tm tm_time;
+    localtime_r(&now.tv_sec, &tm_time);
+    char text[32];
+    size_t length = strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &tm_time);
+    snprintf(text + length, sizeof(text) - length, ".%03ld", static_cast<long>(now.tv_usec / 1000));
+    return text;
+}
+
+} // namespace
+
+StreamTuner::StreamTuner(const std::string& label, const std::atomic<long>& progressBytes, int maxStreams,
+                         const std::string& logPath)
+    : label(label), progressBytes(progressBytes), maxStreams(std::max(1, maxStreams)),
+      log(logPath, std::ios::app), activeStreams(std::min(AUTO_INITIAL_STREAMS, std::max(1, maxStreams))),
+      peak(activeStreams.load()) {
+    if (!log) {
+        std::cerr << " 无法打开调节日志: " << logPath << std::endl;
+    }
+    log << timestamp() << " [" << label << "] 开始: 初始流数 " << activeStreams << ", 上限 " << this->maxStreams
+        << std::endl;
+    sampler = std::thread(&StreamTuner::sampleLoop, this);
+}
+
+StreamTuner::~StreamTuner() {
+    finish();
+    sampler.join();
+    log << timestamp() << " [" << label << "] 结束: 最终流数 " << activeStreams << ", 峰值 " << peak << ", 决策 "
+        << decisionCount << " 次" << std::endl;
+}
+
+void StreamTuner::waitForTurn(int streamIndex) {
+    if (streamIndex < activeStreams) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this, streamIndex]() { return streamIndex < activeStreams || finished; });
+}
+
+void StreamTuner::finish() {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+    changed.notify_all();
+}
+
+void StreamTuner::sampleLoop() {
+    long lastBytes = progressBytes;
+    auto lastTime = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!changed.wait_for(lock, std::chrono::milliseconds(TUNER_EPOCH_MS), [this]() { return finished; })) {
+        lock.unlock();
+        long bytes = progressBytes;
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - lastTime).count();
+        decide(seconds > 0 ? (bytes - lastBytes) / seconds : 0);
+        lastBytes = bytes;
+        lastTime = now;
+        lock.lock();
+    }
+}
+
+void StreamTuner::decide(double goodput) {
+    int current = activeStreams;
+    int next = current;
+    const char* reason;
+
+    if (holdEpochs > 0) {
+        // 回退后先在原流数上重新测量基准，停留结束再继续探测
+        referenceStreams = current;
+        referenceGoodput = goodput;
+        if (--holdEpochs == 0) {
+            next = current + direction;
+            reason = "重新测量完成，继续探测";
+        } else {
+            reason = "回退后保持";
+        }
+    } else if (referenceStreams == 0) {
+        referenceStreams = current;
+        referenceGoodput = goodput;
+        next = current * 2;
+        reason = "初始基准";
+    } else if (goodput > referenceGoodput * (1 + TUNER_GAIN_THRESHOLD)) {
+        referenceStreams = current;
+        referenceGoodput = goodput;
+        next = (startup && direction > 0) ? current * 2 : current + direction;
+        reason = "吞吐提升，沿同方向继续";
+    } else if (goodput < referenceGoodput * (1 - TUNER_GAIN_THRESHOLD) || current > referenceStreams) {
+        if (current > referenceStreams) {
+            reason = "增加流数没有收益，回退";
+        } else if (current < referenceStreams) {
+            reason = "减少流数后吞吐下降，回退";
+        } else {
+            reason = "吞吐下降，保持并重新测量";
+        }
+        startup = false;
+        direction = (current > referenceStreams) ? -1 : 1;
+        next = referenceStreams;
+        holdEpochs = TUNER_HOLD_EPOCHS;
+    } else {
+        // 流数不变或减少后吞吐持平: 接受当前流数，继续尝试用更少的流
+        startup = false;
+        referenceStreams = current;
+        referenceGoodput = goodput;
+        next = current + direction;
+        reason = "吞吐持平";
+    }
+
+    // 到达上下限时反向，下次从另一侧探测
+    if (next < 1 || next > maxStreams) {
+        direction = -direction;
+        next = std::max(1, std::min(next, maxStreams));
+    }
+
+    epoch++;
+    decisionCount++;
+    log << timestamp() << " [" << label << "] 周期 " << epoch << ": 吞吐 " << std::fixed << std::setprecision(2)
+        << goodput / (1024 * 1024) << " MB/s, 流数 " << current << " -> " << next << " (" << reason << ")"
+        << std::endl;
+
+    if (next != current) {
+        setStreams(next);
+    }
+}
+
+void StreamTuner::setStreams(int count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    activeStreams = count;
+    peak = std::max(peak.load(), count);
+    changed.notify_all();
+}
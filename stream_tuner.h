@@ -0,0 +1,67 @@
+#ifndef STREAM_TUNER_H
+#define STREAM_TUNER_H
+
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+const int AUTO_INITIAL_STREAMS = 2;
+const int AUTO_CHUNKS_PER_STREAM = 4;           // 自动选块大小时每条流平均分到的块数
+const int TUNER_EPOCH_MS = 500;                 // 每个测量周期的长度
+const double TUNER_GAIN_THRESHOLD = 0.05;       // 吞吐变化小于 5% 视为持平
+const int TUNER_HOLD_EPOCHS = 2;                // 回退后在原流数上停留的周期数
+
+// 并行流数自动调节 (爬山法): 每个周期测量有效吞吐，据此增减活动流数。
+// 起步阶段流数翻倍，吞吐不再明显增长后改为逐条增减；某个方向吞吐下降或增加流数没有收益时
+// 回退到上一个流数并反向，停留几个周期重新测量后继续探测，网络条件变化时能跟着移动。
+// 每次决策追加写入日志文件，便于事后核对。
+class StreamTuner {
+public:
+    StreamTuner(const std::string& label, const std::atomic<long>& progressBytes, int maxStreams,
+                const std::string& logPath);
+    ~StreamTuner();
+
+    StreamTuner(const StreamTuner&) = delete;
+    StreamTuner& operator=(const StreamTuner&) = delete;
+
+    // 工作线程领取下一个块前调用，编号不小于当前流数的线程在此等待；传输结束后不再等待
+    void waitForTurn(int streamIndex);
+    // 没有可领取的块或传输出错时调用，唤醒所有等待的线程并停止测量
+    void finish();
+
+    int streams() const { return activeStreams; }
+    int peakStreams() const { return peak; }
+    int decisions() const { return decisionCount; }
+
+private:
+    void sampleLoop();
+    void decide(double goodput);
+    void setStreams(int count);
+
+    std::string label;
+    const std::atomic<long>& progressBytes;
+    int maxStreams;
+    std::ofstream log;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::atomic<int> activeStreams;
+    bool finished = false;
+
+    // 仅由测量线程访问
+    int referenceStreams = 0;        // 0 表示还没有基准
+    double referenceGoodput = 0;
+    int direction = 1;
+    bool startup = true;
+    int holdEpochs = 0;
+    int epoch = 0;
+    std::atomic<int> peak;
+    std::atomic<int> decisionCount{0};
+
+    std::thread sampler;
+};
+
+#endif
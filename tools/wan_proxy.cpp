@@ -0,0 +1,394 @@
+// WAN 链路模拟代理: 在本机转发 TCP 连接，对每个方向的数据加入单向延迟、抖动、带宽限制、
+// 丢包重传停顿和每条连接不同的额外延迟，在回环上复现长肥网络下的传输表现，不需要 root 和 netem。
+//
+// 代理每段数据都按到达时间排队，到点才发往对端；每条连接每个方向的在途数据不超过窗口大小，
+// 窗口在数据送达后再经过一个单向延迟 (模拟 ACK 返回) 才释放，因此单连接吞吐不超过 窗口/往返时间，
+// 与真实链路上受 TCP 窗口限制的单流一样。
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const size_t SEGMENT_SIZE = 16 * 1024;
+const auto MIN_RETRANSMIT_TIMEOUT = std::chrono::milliseconds(200);   // Linux TCP 的最小 RTO
+
+struct ProxyConfig {
+    int listenPort = 0;
+    std::string targetIP;
+    int targetPort = 0;
+    double delayMs = 0;
+    double jitterMs = 0;
+    double rateMbit = 0;          // 每条连接每个方向，0 表示不限
+    double linkRateMbit = 0;      // 所有连接共享的瓶颈，0 表示不限
+    size_t windowBytes = 4 * 1024 * 1024;
+    double lossPercent = 0;
+    double reorderMs = 0;
+    unsigned seed = 1;
+};
+
+ProxyConfig config;
+
+// 共享瓶颈: 每个方向一条，所有连接的数据依次占用
+struct SharedLink {
+    std::mutex mutex;
+    Clock::time_point freeAt;
+};
+SharedLink links[2];
+
+std::mutex randomMutex;
+std::mt19937 randomEngine;
+
+double randomUniform(double low, double high) {
+    std::lock_guard<std::mutex> lock(randomMutex);
+    return std::uniform_real_distribution<double>(low, high)(randomEngine);
+}
+
+Clock::duration milliseconds(double ms) {
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+}
+
+Clock::duration serializationTime(size_t bytes, double rateMbit) {
+    if (rateMbit <= 0) {
+        return Clock::duration::zero();
+    }
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(bytes * 8 / (rateMbit * 1e6)));
+}
+
+struct Segment {
+    std::vector<char> data;       // 为空表示发送方已关闭写端
+    Clock::time_point deliverAt;
+};
+
+class Connection;
+
+// 一个方向的数据流: 读线程收数据并排队，写线程按到达时间发出
+class Pipe {
+public:
+    Pipe(Connection& owner, int from, int to, int direction) : owner(owner), from(from), to(to), direction(direction) {}
+
+    void start();
+    void abort();
+    long long bytes() const { return totalBytes; }
+
+private:
+    void readLoop();
+    void writeLoop();
+    Clock::time_point scheduleDelivery(size_t bytes);
+
+    Connection& owner;
+    int from;
+    int to;
+    int direction;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Segment> queue;
+    std::deque<std::pair<Clock::time_point, size_t>> acks;   // 已送达、等待窗口释放的数据
+    size_t inFlight = 0;
+    bool aborted = false;
+
+    Clock::time_point pipeFreeAt;
+    Clock::time_point lastDelivery;
+    std::atomic<long long> totalBytes{0};
+};
+
+class Connection : public std::enable_shared_from_this<Connection> {
+public:
+    Connection(int id, int clientSocket, int serverSocket)
+        : id(id), clientSocket(clientSocket), serverSocket(serverSocket),
+          upstream(*this, clientSocket, serverSocket, 0), downstream(*this, serverSocket, clientSocket, 1) {
+        // 每条连接额外的固定延迟不同，并行连接之间的数据不再按发送顺序到达
+        extraDelay = config.reorderMs > 0 ? milliseconds(randomUniform(0, config.reorderMs)) : Clock::duration::zero();
+    }
+
+    ~Connection() {
+        close(clientSocket);
+        close(serverSocket);
+        std::cout << " 连接 " << id << " 结束: 上行 " << upstream.bytes() << " 字节, 下行 " << downstream.bytes()
+                  << " 字节" << std::endl;
+    }
+
+    void start() {
+        upstream.start();
+        downstream.start();
+    }
+
+    // 任一方向出错时整个连接结束
+    void abort() {
+        shutdown(clientSocket, SHUT_RDWR);
+        shutdown(serverSocket, SHUT_RDWR);
+        upstream.abort();
+        downstream.abort();
+    }
+
+    Clock::duration extraDelay;
+
+private:
+    int id;
+    int clientSocket;
+    int serverSocket;
+    Pipe upstream;
+    Pipe downstream;
+};
+
+void Pipe::start() {
+    std::shared_ptr<Connection> connection = owner.shared_from_this();
+    std::thread([this, connection]() { readLoop(); }).detach();
+    std::thread([this, connection]() { writeLoop(); }).detach();
+}
+
+void Pipe::abort() {
+    std::lock_guard<std::mutex> lock(mutex);
+    aborted = true;
+    changed.notify_all();
+}
+
+Clock::time_point Pipe::scheduleDelivery(size_t bytes) {
+    auto now = Clock::now();
+
+    // 先占用本连接的带宽，再占用共享瓶颈
+    pipeFreeAt = std::max(now, pipeFreeAt) + serializationTime(bytes, config.rateMbit);
+    Clock::time_point departure = pipeFreeAt;
+    if (config.linkRateMbit > 0) {
+        SharedLink& link = links[direction];
+        std::lock_guard<std::mutex> lock(link.mutex);
+        link.freeAt = std::max(departure, link.freeAt) + serializationTime(bytes, config.linkRateMbit);
+        departure = link.freeAt;
+    }
+
+    Clock::time_point deliverAt = departure + milliseconds(config.delayMs) + owner.extraDelay;
+    if (config.jitterMs > 0) {
+        deliverAt += milliseconds(randomUniform(0, config.jitterMs));
+    }
+    // 丢失的段要等重传超时后才能送达，TCP 按序交付，后面的数据一起等待
+    if (config.lossPercent > 0 && randomUniform(0, 100) < config.lossPercent) {
+        deliverAt += MIN_RETRANSMIT_TIMEOUT + milliseconds(2 * config.delayMs);
+    }
+    lastDelivery = std::max(lastDelivery, deliverAt);
+    return lastDelivery;
+}
+
+void Pipe::readLoop() {
+    std::vector<char> buffer(SEGMENT_SIZE);
+    while (true) {
+        {
+            // 在途数据达到窗口时等待 ACK 返回
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!aborted) {
+                auto now = Clock::now();
+                while (!acks.empty() && acks.front().first <= now) {
+                    inFlight -= acks.front().second;
+                    acks.pop_front();
+                }
+                if (inFlight < config.windowBytes) {
+                    break;
+                }
+                if (acks.empty()) {
+                    changed.wait(lock);
+                } else {
+                    changed.wait_until(lock, acks.front().first);
+                }
+            }
+            if (aborted) {
+                return;
+            }
+        }
+
+        ssize_t received = recv(from, buffer.data(), buffer.size(), 0);
+        Segment segment;
+        if (received > 0) {
+            segment.data.assign(buffer.data(), buffer.data() + received);
+            totalBytes += received;
+        }
+        segment.deliverAt = scheduleDelivery(received > 0 ? received : 0);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight += segment.data.size();
+        queue.push_back(std::move(segment));
+        changed.notify_all();
+        if (received <= 0) {
+            return;
+        }
+    }
+}
+
+void Pipe::writeLoop() {
+    while (true) {
+        Segment segment;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!aborted && (queue.empty() || queue.front().deliverAt > Clock::now())) {
+                if (queue.empty()) {
+                    changed.wait(lock);
+                } else {
+                    changed.wait_until(lock, queue.front().deliverAt);
+                }
+            }
+            if (aborted) {
+                return;
+            }
+            segment = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        if (segment.data.empty()) {
+            // 对端关闭写端后把关闭也转发过去
+            shutdown(to, SHUT_WR);
+            return;
+        }
+
+        size_t sent = 0;
+        while (sent < segment.data.size()) {
+            ssize_t result = send(to, segment.data.data() + sent, segment.data.size() - sent, MSG_NOSIGNAL);
+            if (result <= 0) {
+                owner.abort();
+                return;
+            }
+            sent += result;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        acks.emplace_back(Clock::now() + milliseconds(config.delayMs) + owner.extraDelay, segment.data.size());
+        changed.notify_all();
+    }
+}
+
+int connectTarget() {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config.targetPort);
+    if (inet_pton(AF_INET, config.targetIP.c_str(), &addr.sin_addr) <= 0 ||
+        connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+void usage(const char* program) {
+    std::cerr << "用法: " << program << " --listen 端口 --target IP:端口 [选项]\n"
+              << "  --delay MS        单向延迟，往返时间为两倍 [0]\n"
+              << "  --jitter MS       每段额外随机延迟 0~MS，不改变字节顺序 [0]\n"
+              << "  --rate MBIT       每条连接每个方向的带宽上限 Mbit/s [不限]\n"
+              << "  --link-rate MBIT  所有连接共享的瓶颈带宽 (每个方向) [不限]\n"
+              << "  --window KB       每条连接每个方向的在途数据上限，单连接吞吐不超过 窗口/往返时间 [4096]\n"
+              << "  --loss PCT        每段按此概率丢失，重传超时后才送达，其后数据一起等待 [0]\n"
+              << "  --reorder MS      每条连接随机额外延迟 0~MS，并行连接之间的数据乱序到达 [0]\n"
+              << "  --seed N          随机数种子 [1]\n";
+}
+
+bool parseArguments(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--listen") {
+            config.listenPort = std::atoi(value.c_str());
+        } else if (arg == "--target") {
+            size_t colon = value.rfind(':');
+            if (colon == std::string::npos) {
+                return false;
+            }
+            config.targetIP = value.substr(0, colon);
+            config.targetPort = std::atoi(value.c_str() + colon + 1);
+        } else if (arg == "--delay") {
+            config.delayMs = std::atof(value.c_str());
+        } else if (arg == "--jitter") {
+            config.jitterMs = std::atof(value.c_str());
+        } else if (arg == "--rate") {
+            config.rateMbit = std::atof(value.c_str());
+        } else if (arg == "--link-rate") {
+            config.linkRateMbit = std::atof(value.c_str());
+        } else if (arg == "--window") {
+            config.windowBytes = std::max(1L, std::atol(value.c_str())) * 1024;
+        } else if (arg == "--loss") {
+            config.lossPercent = std::atof(value.c_str());
+        } else if (arg == "--reorder") {
+            config.reorderMs = std::atof(value.c_str());
+        } else if (arg == "--seed") {
+            config.seed = static_cast<unsigned>(std::atol(value.c_str()));
+        } else {
+            return false;
+        }
+    }
+    return config.listenPort > 0 && config.targetPort > 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (!parseArguments(argc, argv)) {
+        usage(argv[0]);
+        return 2;
+    }
+    randomEngine.seed(config.seed);
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int opt = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(config.listenPort);
+    if (bind(listener, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listener, 128) < 0) {
+        std::cerr << "无法监听端口 " << config.listenPort << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    std::cout << " 代理 127.0.0.1:" << config.listenPort << " -> " << config.targetIP << ":" << config.targetPort
+              << " (单向延迟 " << config.delayMs << " ms, 抖动 " << config.jitterMs << " ms, 带宽 "
+              << (config.rateMbit > 0 ? std::to_string(config.rateMbit) + " Mbit/s" : "不限") << ", 共享瓶颈 "
+              << (config.linkRateMbit > 0 ? std::to_string(config.linkRateMbit) + " Mbit/s" : "不限") << ", 窗口 "
+              << config.windowBytes / 1024 << " KB, 丢包 " << config.lossPercent << "%, 乱序 " << config.reorderMs
+              << " ms)" << std::endl;
+
+    int nextId = 1;
+    while (true) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        int server = connectTarget();
+        if (server < 0) {
+            std::cerr << " 无法连接目标 " << config.targetIP << ":" << config.targetPort << std::endl;
+            close(client);
+            continue;
+        }
+        int noDelay = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        setsockopt(server, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        auto connection = std::make_shared<Connection>(nextId++, client, server);
+        connection->start();
+    }
+}
@@ -0,0 +1,172 @@
+#include "trace.h"
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+std::atomic<bool> Trace::active{false};
+
+namespace {
+
+struct ThreadBuffer;
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadBuffer*> live;
+    std::vector<TraceEvent> retired;        // 已退出线程的事件
+    std::map<int, std::string> threadNames;
+    std::atomic<long long> recorded{0};
+    std::atomic<long long> dropped{0};
+};
+
+// 与 BufferPool 一样有意不析构，线程在静态析构之后退出时仍可并入
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+// 线程自己的事件缓冲区。锁只在导出时才会有竞争
+struct ThreadBuffer {
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    int threadId = static_cast<int>(syscall(SYS_gettid));
+    bool registered = false;
+
+    ~ThreadBuffer() {
+        if (!registered) {
+            return;
+        }
+        Registry& state = registry();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        std::lock_guard<std::mutex> eventsLock(mutex);
+        std::move(events.begin(), events.end(), std::back_inserter(state.retired));
+        state.live.erase(std::find(state.live.begin(), state.live.end(), this));
+    }
+};
+
+thread_local ThreadBuffer localBuffer;
+
+ThreadBuffer& threadBuffer() {
+    if (!localBuffer.registered) {
+        Registry& state = registry();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.live.push_back(&localBuffer);
+        localBuffer.registered = true;
+    }
+    return localBuffer;
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c));
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void writeEvent(std::ostream& out, const TraceEvent& event, int processId) {
+    out << "{\"name\":\"" << jsonEscape(event.name) << "\",\"cat\":\"" << event.category
+        << "\",\"ph\":\"X\",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs
+        << ",\"pid\":" << processId << ",\"tid\":" << event.threadId;
+    if (!event.args.empty()) {
+        out << ",\"args\":{";
+        for (size_t i = 0; i < event.args.size(); i++) {
+            out << (i ? "," : "") << "\"" << event.args[i].first << "\":" << event.args[i].second;
+        }
+        out << "}";
+    }
+    out << "}";
+}
+
+} // namespace
+
+// 直接用 steady_clock (CLOCK_MONOTONIC) 的绝对值，同一台机器上其他进程写出的事件可以放进同一个时间线
+long long Trace::nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::nameThread(const std::string& name) {
+    if (!enabled()) {
+        return;
+    }
+    int threadId = threadBuffer().threadId;
+    Registry& state = registry();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.threadNames[threadId] = name;
+}
+
+void Trace::record(TraceEvent&& event) {
+    Registry& state = registry();
+    if (state.recorded.fetch_add(1, std::memory_order_relaxed) >= TRACE_EVENT_LIMIT) {
+        state.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ThreadBuffer& buffer = threadBuffer();
+    event.threadId = buffer.threadId;
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back(std::move(event));
+}
+
+TraceRecorder::TraceRecorder(const std::string& path) : path(path) {
+    Trace::active.store(true, std::memory_order_relaxed);
+}
+
+TraceRecorder::~TraceRecorder() {
+    Trace::active.store(false, std::memory_order_relaxed);
+
+    Registry& state = registry();
+    std::vector<TraceEvent> events;
+    std::map<int, std::string> threadNames;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        events.swap(state.retired);
+        for (ThreadBuffer* buffer : state.live) {
+            std::lock_guard<std::mutex> eventsLock(buffer->mutex);
+            std::move(buffer->events.begin(), buffer->events.end(), std::back_inserter(events));
+            buffer->events.clear();
+        }
+        threadNames.swap(state.threadNames);
+    }
+    long long dropped = state.dropped.exchange(0);
+    state.recorded = 0;
+
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cerr << " 无法写入跟踪文件: " << path << std::endl;
+        return;
+    }
+
+    int processId = static_cast<int>(getpid());
+    out << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":" << dropped << "},\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << processId
+        << ",\"args\":{\"name\":\"file_transfer_client\"}}";
+    for (const auto& entry : threadNames) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << processId << ",\"tid\":" << entry.first
+            << ",\"args\":{\"name\":\"" << jsonEscape(entry.second) << "\"}}";
+    }
+    for (const TraceEvent& event : events) {
+        out << ",\n";
+        writeEvent(out, event, processId);
+    }
+    out << "\n]}\n";
+
+    std::cout << " 时间线已写入 " << path << " (" << events.size() << " 个事件";
+    if (dropped > 0) {
+        std::cout << ", 超出上限丢弃 " << dropped << " 个";
+    }
+    std::cout << ")，可在 chrome://tracing 或 ui.perfetto.dev 中打开" << std::endl;
+}
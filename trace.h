@@ -0,0 +1,102 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <chrono>
+
+const long long TRACE_EVENT_LIMIT = 2000000;    // 超出后丢弃新事件，避免长时间传输占满内存
+
+struct TraceEvent {
+    std::string name;
+    const char* category;
+    long long startUs;
+    long long durationUs;
+    int threadId;
+    std::vector<std::pair<const char*, long long>> args;
+};
+
+// 传输时间线跟踪: 记录各块、各连接每个阶段的起止时间，导出为 Chrome/Perfetto 的 trace JSON
+// (chrome://tracing 或 ui.perfetto.dev 打开)。
+// 事件先存进各线程自己的缓冲区 (锁只在导出时才有竞争)，线程退出时并入全局列表，结束时统一写出。
+// 默认关闭，关闭时每个跟踪点只有一次原子读。
+class Trace {
+public:
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+    // 给当前线程命名，显示在时间线的线程名称栏
+    static void nameThread(const std::string& name);
+
+private:
+    friend class TraceSpan;
+    friend class TraceRecorder;
+    static void record(TraceEvent&& event);
+    static long long nowUs();
+
+    static std::atomic<bool> active;
+};
+
+// 一个阶段: 构造时开始，end() 或析构时结束并记录
+class TraceSpan {
+public:
+    // 关闭时不构造名称字符串
+    TraceSpan(const char* category, const char* name) : running(Trace::enabled()) {
+        if (running) {
+            begin(category, name);
+        }
+    }
+    TraceSpan(const char* category, const char* prefix, long long number) : running(Trace::enabled()) {
+        if (running) {
+            begin(category, prefix + std::to_string(number));
+        }
+    }
+    TraceSpan(const char* category, std::string name) : running(Trace::enabled()) {
+        if (running) {
+            begin(category, std::move(name));
+        }
+    }
+    ~TraceSpan() { end(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    // 附加数值参数，在时间线中点选事件时显示
+    void arg(const char* key, long long value) {
+        if (running) {
+            event.args.emplace_back(key, value);
+        }
+    }
+    void end() {
+        if (running) {
+            running = false;
+            event.durationUs = Trace::nowUs() - event.startUs;
+            Trace::record(std::move(event));
+        }
+    }
+
+private:
+    void begin(const char* category, std::string name) {
+        event.name = std::move(name);
+        event.category = category;
+        event.startUs = Trace::nowUs();
+    }
+
+    bool running;
+    TraceEvent event;
+};
+
+// 开启跟踪，析构时把所有已结束的阶段写入文件。应在传输线程全部结束后析构
+class TraceRecorder {
+public:
+    explicit TraceRecorder(const std::string& path);
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+private:
+    std::string path;
+};
+
+#endif
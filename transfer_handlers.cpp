@@ -1,31 +1,101 @@
 #include "transfer_handlers.h"
 #include "network_utils.h"
+#include "wire_protocol.h"
+#include "file_batch.h"
+#include "resume_journal.h"
+#include "delta_sync.h"
+#include "checksum.h"
+#include "buffer_pool.h"
+#include "connection_pool.h"
+#include "read_pipeline.h"
+#include "chunk_dedup.h"
+#include "sparse_file.h"
+#include "directory_manifest.h"
+#include "directory_scanner.h"
+#include "stream_tuner.h"
+#include "metrics.h"
+#include "trace.h"
+#include "logger.h"
+#include "alloc_counter.h"
 #include "../common/file_attributes.h"
 #include "../common/constants.h"
 #include <iostream>
 #include <fstream>
 #include <thread>
 #include <vector>
+#include <deque>
+#include <memory>
 #include <atomic>
 #include <mutex>
 #include <algorithm>
 #include <chrono>
 #include <iomanip>
-#include <dirent.h>
+#include <sstream>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <cstring>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <fcntl.h>
+
+// 零拷贝模式下每次 sendfile 的最大字节数，用于刷新进度
+const long long ZERO_COPY_SLICE = 4 * 1024 * 1024;
+// 单个块连接中断后最多尝试的次数
+const int MAX_CHUNK_ATTEMPTS = 3;
+const uint32_t CONTROL_FLAG_RESUME = 1;
+const uint8_t DOWNLOAD_FLAG_CHECKSUM = 1;   // 请求服务器在每个范围之后附带 ChunkChecksum 帧
+const size_t SPARSE_EXTENT_RESERVE = 64;    // 每个发送线程的稀疏区间表预留的个数
+
+namespace {
+
+// 当前发送线程最近一块中预读线程的堆分配次数，与发送线程自身的次数一起计入热路径统计
+thread_local long long chunkReaderAllocations = 0;
+
+// 已发出、尚未收到块确认的字节数，每次发送后记录一次
+void addInFlight(long long& inFlight, long long bytes) {
+    inFlight += bytes;
+    Metrics::record(Histogram::BytesInFlight, Metrics::adjust(Gauge::BytesInFlight, bytes));
+}
+
+// 能打开并 fstat 的项才计入目录头
+bool entryReadable(const std::string& fullPath, bool isDirectory) {
+    int fd = open(fullPath.c_str(), O_RDONLY | (isDirectory ? O_DIRECTORY : 0));
+    if (fd < 0) {
+        return false;
+    }
+    struct stat fileStat;
+    bool readable = fstat(fd, &fileStat) == 0 && (isDirectory ? S_ISDIR(fileStat.st_mode) : S_ISREG(fileStat.st_mode));
+    close(fd);
+    return readable;
+}
+
+} // namespace
+
+TransferHandlers::TransferHandlers(const std::string& ip, int port, const TransferOptions& opts) 
+    : serverIP(ip), serverPort(port), options(opts) {
+    if (!options.metricsPath.empty()) {
+        metrics = std::make_unique<MetricsReporter>(options.metricsPath, options.metricsIntervalMs);
+    }
+    if (!options.tracePath.empty()) {
+        trace = std::make_unique<TraceRecorder>(options.tracePath);
+        Trace::nameThread("main");
+    }
+}
 
-TransferHandlers::TransferHandlers(const std::string& ip, int port) 
-    : serverIP(ip), serverPort(port) {}
+TransferHandlers::~TransferHandlers() = default;
 
 void TransferHandlers::sequentialTransfer(const std::string& filePath) {
+    MetricsSession metricsSession(metrics.get(), "seq " + filePath);
+    TraceSpan transferSpan("transfer", "seq " + filePath);
     std::cout << " 启动顺序传输模式..." << std::endl;
     
     auto startTime = std::chrono::steady_clock::now();
+    double cpuStart = NetworkUtils::processCpuSeconds();
     TransferStats stats;
     stats.startTime = startTime;
 
@@ -51,27 +121,50 @@ void TransferHandlers::sequentialTransfer(const std::string& filePath) {
         FileAttributes attrs = NetworkUtils::getFileAttributes(filePath);
         NetworkUtils::displayFileAttributes(filePath, attrs, fileSize);
 
+        negotiateProtocol();
+
         std::cout << " 连接服务器 " << serverIP << ":" << serverPort << "..." << std::endl;
-        int controlSocket = NetworkUtils::createConnection(serverIP, serverPort);
+        int controlSocket = acquireConnection();
 
         // 查询断点信息
         ResumeInfo resumeInfo = checkResumeInfo(controlSocket, fileName, fileSize);
         
         long startPos = 0;
+        bool resetSent = false;
         if (resumeInfo.exists && resumeInfo.transferred > 0 && resumeInfo.transferred < fileSize) {
             std::cout << " 发现断点，已传输: " << resumeInfo.transferred << "/" << fileSize << " 字节" << std::endl;
-            std::cout << "↩↩ 是否继续传输? (y/n): ";
-            std::string choice;
-            std::getline(std::cin, choice);
+            bool resume = options.resumePolicy == ResumePolicy::Resume;
+            if (options.resumePolicy == ResumePolicy::Refuse) {
+                close(controlSocket);
+                throw std::runtime_error("服务器上有未完成的传输，请用 --resume 继续或 --restart 重新开始");
+            } else if (options.resumePolicy == ResumePolicy::Ask) {
+                std::cout << "↩↩ 是否继续传输? (y/n): ";
+                std::string choice;
+                std::getline(std::cin, choice);
+                resume = choice == "y" || choice == "Y";
+            }
             
-            if (choice == "y" || choice == "Y") {
+            if (resume) {
                 startPos = resumeInfo.transferred;
                 std::cout << " 从 " << startPos << " 字节处继续传输..." << std::endl;
             } else {
                 std::cout << " 重新开始传输..." << std::endl;
                 // 发送重置命令
-                char resetCmd = 'R';
-                send(controlSocket, &resetCmd, 1, 0);
+                bool resetDelivered;
+                if (protocolVersion >= 2) {
+                    WireMessage reset(FrameType::ResumeReset);
+                    reset.putString(fileName);
+                    resetDelivered = reset.sendAll(controlSocket);
+                } else {
+                    WireMessage reset;
+                    reset.putNative('R');
+                    resetDelivered = reset.sendAll(controlSocket);
+                }
+                if (!resetDelivered) {
+                    close(controlSocket);
+                    throw std::runtime_error("发送断点重置命令失败");
+                }
+                resetSent = true;
                 startPos = 0;
             }
         } else {
@@ -79,82 +172,153 @@ void TransferHandlers::sequentialTransfer(const std::string& filePath) {
             startPos = 0;
         }
 
-        // 关闭当前连接，重新建立传输连接
-        close(controlSocket);
-        controlSocket = NetworkUtils::createConnection(serverIP, serverPort);
-
-        char mode = 'S';
-        if (send(controlSocket, &mode, 1, 0) <= 0) {
-            close(controlSocket);
-            throw std::runtime_error("发送模式标识失败");
-        }
-
-        // 发送起始位置
-        if (send(controlSocket, &startPos, sizeof(long long), 0) <= 0) {
+        // 服务器保持连接时直接在查询连接上传输，否则关闭当前连接，重新建立传输连接
+        if (!keepAlive() || resetSent) {
             close(controlSocket);
-            throw std::runtime_error("发送起始位置失败");
+            controlSocket = acquireConnection();
         }
 
-        if (send(controlSocket, &attrs, sizeof(FileAttributes), 0) <= 0) {
+        int fd = open(filePath.c_str(), O_RDONLY);
+        if (fd < 0) {
             close(controlSocket);
-            throw std::runtime_error("发送文件属性失败");
+            throw std::runtime_error("无法打开文件");
         }
 
-        int fileNameSize = fileName.size();
-        if (send(controlSocket, &fileNameSize, sizeof(int), 0) <= 0) {
-            close(controlSocket);
-            throw std::runtime_error("发送文件名长度失败");
+        // 稀疏文件只发送数据区，空洞由服务器保留
+        std::vector<FileExtent> extents{{startPos, fileSize - startPos}};
+        bool sparse = protocolVersion >= 2 && options.sparseFiles && SparseFile::isSparse(fileStat);
+        if (sparse) {
+            extents = SparseFile::dataExtents(fd, startPos, fileSize - startPos);
         }
-        
-        if (send(controlSocket, fileName.c_str(), fileNameSize, 0) <= 0) {
-            close(controlSocket);
-            throw std::runtime_error("发送文件名失败");
+        long long dataBytes = SparseFile::dataBytes(extents);
+
+        // 模式、起始位置、属性、文件名和大小合并为一次 writev 发出
+        bool headerSent = false;
+        if (protocolVersion >= 2) {
+            WireMessage header(sparse ? FrameType::SparseSequential : FrameType::Sequential);
+            header.put(static_cast<uint64_t>(startPos));
+            header.putAttributes(attrs);
+            header.putString(fileName);
+            header.put(static_cast<uint64_t>(fileSize));
+            headerSent = header.sendAll(controlSocket) && (!sparse || SparseFile::sendExtentMap(controlSocket, extents));
+        } else {
+            WireMessage header;
+            header.putNative('S');
+            header.putNative(static_cast<long long>(startPos));
+            header.putNative(attrs);
+            header.putNative(static_cast<int>(fileName.size()));
+            header.putBytes(fileName.data(), fileName.size());
+            header.putNative(static_cast<long long>(fileSize));
+            headerSent = header.sendAll(controlSocket);
         }
 
-        if (send(controlSocket, &fileSize, sizeof(long long), 0) <= 0) {
+        if (!headerSent) {
+            close(fd);
             close(controlSocket);
-            throw std::runtime_error("发送文件大小失败");
+            throw std::runtime_error("发送传输头信息失败");
         }
 
+        if (sparse) {
+            std::cout << " 稀疏文件: " << extents.size() << " 个数据区, 实际数据 " << dataBytes << "/"
+                      << (fileSize - startPos) << " 字节" << std::endl;
+        }
         std::cout << " 开始传输文件数据..." << std::endl;
 
-        std::ifstream file(filePath, std::ios::binary);
-        if (!file.is_open()) {
-            close(controlSocket);
-            throw std::runtime_error("无法打开文件");
-        }
+        // 断点续传时只能校验本次发送的部分，服务器按同一范围计算
+        uint32_t fileCrc = 0;
+        long long dataSent = 0;
+        long sent = startPos;
+        // 每次发送后都会调用，按固定间隔输出
+        ProgressThrottle progressThrottle;
+        auto reportProgress = [&](bool final) {
+            stats.totalSent = sent;
+            if (!final && !progressThrottle.due()) {
+                return;
+            }
+            double progress = (double)sent / fileSize * 100;
+            auto currentTime = std::chrono::steady_clock::now();
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - startTime).count();
+            double speed = (duration > 0) ? (double)dataSent / duration / 1024 : 0;
+
+            std::ostringstream line;
+            line << " 进度: " << std::fixed << std::setprecision(1) << progress
+                 << "%, 速度: " << std::setprecision(2) << speed << " KB/s";
+            Logger::progress(line.str());
+        };
+
+        if (usesZeroCopy()) {
+            bool zeroCopy = true;
+
+            for (const auto& extent : extents) {
+                long long extentSent = 0;
+                while (extentSent < extent.length) {
+                    long long offset = extent.offset + extentSent;
+                    long long toSend = std::min(ZERO_COPY_SLICE, extent.length - extentSent);
+                    long long bytesSent = NetworkUtils::sendFileRange(controlSocket, fd, offset, toSend, zeroCopy);
+                    if (bytesSent <= 0) {
+                        close(fd);
+                        close(controlSocket);
+                        throw std::runtime_error("数据传输失败");
+                    }
+                    extentSent += bytesSent;
+                    dataSent += bytesSent;
+                    sent = offset + bytesSent;
+                    reportProgress(false);
+                }
+            }
 
-        // 跳转到断点位置
-        file.seekg(startPos);
+            if (!zeroCopy) {
+                zeroCopyFallback = true;
+            }
+        } else {
+            bool sendFailed = false;
 
-        char buffer[BUFFER_SIZE];
-        long sent = startPos;
-        
-        while (!file.eof() && sent < fileSize) {
-            file.read(buffer, sizeof(buffer));
-            int bytesRead = file.gcount();
-            
-            if (bytesRead > 0) {
-                int bytesSent = send(controlSocket, buffer, bytesRead, 0);
-                if (bytesSent <= 0) {
-                    file.close();
-                    close(controlSocket);
-                    throw std::runtime_error("数据传输失败");
+            {
+                // 从断点位置开始预读，磁盘读取与发送重叠进行
+                ReadAheadPipeline pipeline(fd, extents);
+                const char* buffer;
+                size_t bytesRead;
+                long long offset;
+                while (!sendFailed && pipeline.next(buffer, bytesRead, &offset)) {
+                    if (sendsChecksums()) {
+                        fileCrc = updateChecksum(fileCrc, buffer, bytesRead);
+                    }
+                    size_t bytesSent = 0;
+                    while (bytesSent < bytesRead) {
+                        ssize_t result = send(controlSocket, buffer + bytesSent, bytesRead - bytesSent, 0);
+                        if (result <= 0) {
+                            sendFailed = true;
+                            break;
+                        }
+                        Metrics::record(Histogram::SendBytes, result);
+                        bytesSent += result;
+                    }
+                    dataSent += bytesSent;
+                    sent = offset + bytesSent;
+                    reportProgress(false);
                 }
-                sent += bytesSent;
-                stats.totalSent = sent;
-                
-                double progress = (double)sent / fileSize * 100;
-                auto currentTime = std::chrono::steady_clock::now();
-                auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - startTime).count();
-                double speed = (duration > 0) ? (double)(sent - startPos) / duration / 1024 : 0;
-                
-                std::cout << " 进度: " << std::fixed << std::setprecision(1) << progress 
-                          << "%, 速度: " << std::setprecision(2) << speed << " KB/s\r" << std::flush;
+                recordPipelineWait(pipeline);
             }
-        }
 
-        file.close();
+            if (sendFailed || dataSent != dataBytes) {
+                close(fd);
+                close(controlSocket);
+                throw std::runtime_error("数据传输失败");
+            }
+        }
+        close(fd);
+        sent = fileSize;
+        reportProgress(true);
+        Logger::flush();
+
+        if (sendsChecksums()) {
+            WireMessage trailer(FrameType::FileChecksum);
+            trailer.put(fileCrc);
+            if (!trailer.sendAll(controlSocket)) {
+                close(controlSocket);
+                throw std::runtime_error("发送文件校验和失败");
+            }
+        }
 
         char response[256];
         int bytesReceived = recv(controlSocket, response, sizeof(response) - 1, 0);
@@ -171,13 +335,174 @@ void TransferHandlers::sequentialTransfer(const std::string& filePath) {
         
         std::cout << "  传输耗时: " << duration << " ms" << std::endl;
         std::cout << " 平均速度: " << std::fixed << std::setprecision(2) << avgSpeed << " KB/s" << std::endl;
+        if (sendsChecksums()) {
+            char crcText[16];
+            snprintf(crcText, sizeof(crcText), "%08x", fileCrc);
+            std::cout << " CRC32C: " << crcText << (startPos > 0 ? " (本次发送部分)" : "") << std::endl;
+        }
+        reportEngineStats(fileSize - startPos, cpuStart);
 
     } catch (const std::exception& e) {
+        Logger::flush();
         std::cerr << "\n 顺序传输错误: " << e.what() << std::endl;
         throw;
     }
 }
 
+void TransferHandlers::deltaTransfer(const std::string& filePath) {
+    MetricsSession metricsSession(metrics.get(), "delta " + filePath);
+    TraceSpan transferSpan("transfer", "delta " + filePath);
+    std::cout << " 启动增量同步模式..." << std::endl;
+
+    auto startTime = std::chrono::steady_clock::now();
+    double cpuStart = NetworkUtils::processCpuSeconds();
+
+    try {
+        struct stat fileStat;
+        if (stat(filePath.c_str(), &fileStat) != 0) {
+            throw std::runtime_error("文件不存在: " + filePath);
+        }
+
+        if (!S_ISREG(fileStat.st_mode)) {
+            throw std::runtime_error("路径不是普通文件: " + filePath);
+        }
+
+        long long fileSize = fileStat.st_size;
+
+        std::string fileName = filePath;
+        size_t lastSlash = fileName.find_last_of("/\\");
+        if (lastSlash != std::string::npos) {
+            fileName = fileName.substr(lastSlash + 1);
+        }
+
+        FileAttributes attrs = NetworkUtils::getFileAttributes(filePath);
+        NetworkUtils::displayFileAttributes(filePath, attrs, fileSize);
+
+        negotiateProtocol();
+        if (protocolVersion < 2) {
+            std::cout << " 服务器不支持增量同步 (需要协议 v2)，改用顺序传输" << std::endl;
+            sequentialTransfer(filePath);
+            return;
+        }
+
+        // 与 rsync 一样按文件大小的平方根选块大小
+        size_t blockSize = static_cast<size_t>(std::sqrt(static_cast<double>(fileSize)));
+        blockSize = std::max(DELTA_MIN_BLOCK_SIZE, std::min(DELTA_MAX_BLOCK_SIZE, blockSize & ~static_cast<size_t>(1023)));
+
+        std::cout << " 连接服务器 " << serverIP << ":" << serverPort << "..." << std::endl;
+        int controlSocket = acquireConnection();
+
+        WireMessage request(FrameType::DeltaRequest);
+        request.putString(fileName);
+        request.put(static_cast<uint64_t>(fileSize));
+        request.putAttributes(attrs);
+        request.put(static_cast<uint32_t>(blockSize));
+        if (!request.sendAll(controlSocket)) {
+            close(controlSocket);
+            throw std::runtime_error("发送增量同步请求失败");
+        }
+
+        // 服务器返回其现有副本每个完整块的签名，签名表以原始字节紧随帧后
+        std::vector<char> payload;
+        if (!WireReader::recvFrame(controlSocket, FrameType::DeltaSignatures, payload)) {
+            close(controlSocket);
+            throw std::runtime_error("接收块签名失败");
+        }
+        WireReader header(payload);
+        blockSize = header.get<uint32_t>();
+        uint32_t blockCount = header.get<uint32_t>();
+        // 块大小和块数来自服务器，先校验再按它们分配签名表
+        if (!header.ok() || blockSize < DELTA_MIN_BLOCK_SIZE || blockSize > DELTA_MAX_BLOCK_SIZE ||
+            blockCount > DELTA_MAX_BLOCK_COUNT) {
+            close(controlSocket);
+            throw std::runtime_error("无效的块签名头: 块大小 " + std::to_string(blockSize) +
+                                     ", 块数 " + std::to_string(blockCount));
+        }
+
+        std::vector<char> table(static_cast<size_t>(blockCount) * DELTA_SIGNATURE_SIZE);
+        if (!table.empty() &&
+            recv(controlSocket, table.data(), table.size(), MSG_WAITALL) != static_cast<ssize_t>(table.size())) {
+            close(controlSocket);
+            throw std::runtime_error("接收块签名失败");
+        }
+        std::vector<BlockSignature> signatures(blockCount);
+        WireReader tableReader(table);
+        for (auto& signature : signatures) {
+            signature.weak = tableReader.get<uint32_t>();
+            signature.strong = tableReader.get<uint64_t>();
+        }
+
+        std::cout << " 服务器已有 " << blockCount << " 个块 (块大小 " << blockSize << " 字节)，开始比对..." << std::endl;
+
+        int fd = open(filePath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            close(controlSocket);
+            throw std::runtime_error("无法打开文件");
+        }
+
+        DeltaEncoder encoder(controlSocket, blockSize, signatures);
+        bool encoded;
+        try {
+            encoded = encoder.encode(fd, fileSize);
+        } catch (...) {
+            close(fd);
+            close(controlSocket);
+            throw;
+        }
+        close(fd);
+
+        if (!encoded) {
+            close(controlSocket);
+            throw std::runtime_error("发送增量数据失败");
+        }
+
+        // 服务器按 DeltaEnd 中的 CRC32C 校验重建结果，不一致时保留原文件
+        std::vector<char> result;
+        if (!WireReader::recvFrame(controlSocket, FrameType::DeltaResult, result)) {
+            close(controlSocket);
+            throw std::runtime_error("未收到增量同步结果");
+        }
+        close(controlSocket);
+        WireReader resultReader(result);
+        uint8_t status = resultReader.get<uint8_t>();
+        std::string message = resultReader.getString();
+        if (!resultReader.ok()) {
+            throw std::runtime_error("无效的增量同步结果");
+        }
+        if (status == DELTA_RESULT_CHECKSUM_MISMATCH) {
+            std::cout << " 服务器重建的文件校验和不一致，改用完整上传" << std::endl;
+            sequentialTransfer(filePath);
+            return;
+        }
+        if (status != DELTA_RESULT_OK) {
+            throw std::runtime_error("增量同步失败: " + message);
+        }
+        if (!message.empty()) {
+            std::cout << " " << message << std::endl;
+        }
+
+        auto endTime = std::chrono::steady_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+        const DeltaStats& deltaStats = encoder.stats();
+        long long wireBytes = deltaStats.wireBytes + request.size() + FRAME_HEADER_SIZE + payload.size() + table.size();
+
+        std::cout << "  传输耗时: " << duration << " ms" << std::endl;
+        std::cout << " 复用: " << deltaStats.matchedBytes << " 字节 (" << deltaStats.copyOps << " 次块引用), "
+                  << "字面数据: " << deltaStats.literalBytes << " 字节" << std::endl;
+        std::cout << " 线上字节: " << wireBytes << " (文件大小的 " << std::fixed << std::setprecision(2)
+                  << (fileSize > 0 ? (double)wireBytes / fileSize * 100 : 0) << "%)" << std::endl;
+        char crcText[16];
+        snprintf(crcText, sizeof(crcText), "%08x", encoder.fileChecksum());
+        std::cout << " CRC32C: " << crcText << " (服务器已校验)" << std::endl;
+        reportEngineStats(fileSize, cpuStart);
+
+    } catch (const std::exception& e) {
+        Logger::flush();
+        std::cerr << "\n 增量同步错误: " << e.what() << std::endl;
+        throw;
+    }
+}
+
 ResumeInfo TransferHandlers::checkResumeInfo(int socket, const std::string& fileName, long fileSize) {
     ResumeInfo info;
     info.fileName = fileName;
@@ -186,18 +511,32 @@ ResumeInfo TransferHandlers::checkResumeInfo(int socket, const std::string& file
     info.exists = false;
 
     try {
-        // 发送查询命令
-        char queryCmd = 'Q';
-        if (send(socket, &queryCmd, 1, 0) <= 0) {
-            return info;
-        }
+        if (protocolVersion >= 2) {
+            WireMessage query(FrameType::ResumeQuery);
+            query.putString(fileName);
+            if (!query.sendAll(socket)) {
+                return info;
+            }
 
-        // 发送文件名
-        int fileNameSize = fileName.size();
-        if (send(socket, &fileNameSize, sizeof(int), 0) <= 0) {
+            std::vector<char> payload;
+            if (!WireReader::recvFrame(socket, FrameType::ResumeInfo, payload)) {
+                return info;
+            }
+            WireReader reader(payload);
+            info.exists = reader.get<uint8_t>() != 0;
+            info.transferred = static_cast<long long>(reader.get<uint64_t>());
+            if (!reader.ok()) {
+                info.exists = false;
+            }
             return info;
         }
-        if (send(socket, fileName.c_str(), fileNameSize, 0) <= 0) {
+
+        // 发送查询命令和文件名
+        WireMessage query;
+        query.putNative('Q');
+        query.putNative(static_cast<int>(fileName.size()));
+        query.putBytes(fileName.data(), fileName.size());
+        if (!query.sendAll(socket)) {
             return info;
         }
 
@@ -220,9 +559,16 @@ ResumeInfo TransferHandlers::checkResumeInfo(int socket, const std::string& file
 }
 
 void TransferHandlers::multithreadedTransfer(const std::string& filePath, int numThreads) {
-    std::cout << " 启动多线程传输模式 (" << numThreads << " 线程)..." << std::endl;
+    MetricsSession metricsSession(metrics.get(), "mt " + filePath);
+    TraceSpan transferSpan("transfer", "mt " + filePath);
+    if (options.autoTuneStreams) {
+        std::cout << " 启动多线程传输模式 (自动调节线程数)..." << std::endl;
+    } else {
+        std::cout << " 启动多线程传输模式 (" << numThreads << " 线程)..." << std::endl;
+    }
     
     auto startTime = std::chrono::steady_clock::now();
+    double cpuStart = NetworkUtils::processCpuSeconds();
     TransferStats stats;
     stats.startTime = startTime;
 
@@ -251,202 +597,548 @@ void TransferHandlers::multithreadedTransfer(const std::string& filePath, int nu
         FileAttributes attrs = NetworkUtils::getFileAttributes(filePath);
         NetworkUtils::displayFileAttributes(filePath, attrs, fileSize);
 
-        std::cout << " 发送控制信息到服务器..." << std::endl;
+        negotiateProtocol();
+
+        std::vector<double> chunkLatencyMs;
+        uploadChunked(filePath, fileName, attrs, fileSize, numThreads, stats, chunkLatencyMs, true);
+
+        auto endTime = std::chrono::steady_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+        double avgSpeed = (duration > 0) ? (double)fileSize / duration / 1024 * 1000 : 0;
         
-        int controlSocket = NetworkUtils::createConnection(serverIP, serverPort);
-        char mode = 'M';
-        if (send(controlSocket, &mode, 1, 0) <= 0) {
-            close(controlSocket);
-            throw std::runtime_error("发送模式标识失败");
-        }
+        std::cout << "\n 多线程传输完成!" << std::endl;
+        std::cout << "  传输耗时: " << duration << " ms" << std::endl;
+        std::cout << " 平均速度: " << std::fixed << std::setprecision(2) << avgSpeed << " KB/s" << std::endl;
+        reportEngineStats(fileSize, cpuStart);
+        reportChunkLatency(chunkLatencyMs);
+        reportCompressionStats(duration);
+        reportDedupStats();
 
-        if (send(controlSocket, &numThreads, sizeof(int), 0) <= 0) {
-            close(controlSocket);
-            throw std::runtime_error("发送线程数失败");
-        }
+    } catch (const std::exception& e) {
+        Logger::flush();
+        std::cerr << "\n 多线程传输错误: " << e.what() << std::endl;
+        throw;
+    }
+}
 
-        if (send(controlSocket, &attrs, sizeof(FileAttributes), 0) <= 0) {
-            close(controlSocket);
-            throw std::runtime_error("发送文件属性失败");
-        }
+void TransferHandlers::uploadChunked(const std::string& filePath, const std::string& remoteName,
+                                     const FileAttributes& attrs, long fileSize, int numThreads,
+                                     TransferStats& stats, std::vector<double>& chunkLatencyMs, bool showProgress) {
+    if (protocolVersion < 2 && fileSize > INT_MAX) {
+        // v1 块头中的偏移和长度是 32 位 int
+        throw std::runtime_error("服务器仅支持协议 v1，多线程模式无法传输超过 2GB 的文件");
+    }
 
-        int fileNameSize = fileName.size();
-        if (send(controlSocket, &fileNameSize, sizeof(int), 0) <= 0) {
-            close(controlSocket);
-            throw std::runtime_error("发送文件名长度失败");
-        }
-        
-        if (send(controlSocket, fileName.c_str(), fileNameSize, 0) <= 0) {
-            close(controlSocket);
-            throw std::runtime_error("发送文件名失败");
+    // 固定大小分块，由线程池从共享队列中领取
+    long chunkSize = transferChunkSize(fileSize);
+    if (protocolVersion < 2) {
+        // v1 服务器把块数截断到 MAX_THREADS，必要时放大块大小
+        chunkSize = std::max(chunkSize, (fileSize + MAX_THREADS - 1) / MAX_THREADS);
+    }
+    int totalChunks = static_cast<int>((fileSize + chunkSize - 1) / chunkSize);
+    // 自动调节时按上限创建线程，实际同时发送的流数由调节器决定
+    int workerCount = std::min(options.autoTuneStreams ? MAX_THREADS : numThreads, totalChunks);
+
+    // 稀疏文件的各块只发送数据区，空洞由服务器保留
+    struct stat fileStat;
+    bool sparse = protocolVersion >= 2 && options.sparseFiles && stat(filePath.c_str(), &fileStat) == 0 &&
+                  SparseFile::isSparse(fileStat);
+
+    // 断点日志记录服务器已确认的块，连接中断或重启后只补发缺失的块
+    ResumeJournal journal;
+    std::string transferKey = serverIP + ":" + std::to_string(serverPort) + "|" + remoteName + "|" +
+                              std::to_string(fileSize) + "|" + std::to_string(attrs.modify_time.tv_sec) + "|" +
+                              std::to_string(chunkSize);
+    bool resuming = false;
+    if (protocolVersion < 2) {
+        // v1 服务器收到控制消息会重建目标文件，无法续传，已完成的块只在内存中记录
+        journal.track(totalChunks);
+    } else if (journal.open(transferKey, totalChunks) && journal.completedCount() > 0) {
+        resuming = true;
+    }
+
+    if (showProgress) {
+        std::cout << " 发送控制信息到服务器..." << std::endl;
+    }
+    
+    int sessionId = 0;
+
+    // 服务器按块数建立 FileSession::chunks，因此发送的是块总数而非线程数
+    bool controlOk = controlRequest([&](int controlSocket) {
+        if (protocolVersion >= 2) {
+            WireMessage control(FrameType::MultithreadControl);
+            control.put(static_cast<uint32_t>(totalChunks));
+            control.put(static_cast<uint64_t>(chunkSize));
+            control.putAttributes(attrs);
+            control.putString(remoteName);
+            control.put(static_cast<uint64_t>(fileSize));
+            std::vector<uint8_t> localBits = journal.bitmap();
+            control.put(resuming ? CONTROL_FLAG_RESUME : 0u);
+            control.put(static_cast<uint32_t>(resuming ? localBits.size() : 0));
+            if (resuming) {
+                control.putBytes(localBits.data(), localBits.size());
+            }
+
+            std::vector<char> payload;
+            if (!control.sendAll(controlSocket) ||
+                !WireReader::recvFrame(controlSocket, FrameType::SessionCreated, payload)) {
+                return false;
+            }
+            WireReader reader(payload);
+            sessionId = static_cast<int>(reader.get<uint32_t>());
+            // 以服务器日志中已落盘的块为准
+            std::string serverBits = reader.getString();
+            if (!reader.ok()) {
+                return false;
+            }
+            if (resuming) {
+                journal.assignBitmap(std::vector<uint8_t>(serverBits.begin(), serverBits.end()));
+            }
+            return true;
         }
-        
-        if (send(controlSocket, &fileSize, sizeof(long), 0) <= 0) {
-            close(controlSocket);
-            throw std::runtime_error("发送文件大小失败");
+
+        WireMessage control;
+        control.putNative('M');
+        control.putNative(totalChunks);
+        control.putNative(attrs);
+        control.putNative(static_cast<int>(remoteName.size()));
+        control.putBytes(remoteName.data(), remoteName.size());
+        control.putNative(static_cast<long long>(fileSize));
+
+        return control.sendAll(controlSocket) &&
+               recv(controlSocket, &sessionId, sizeof(int), MSG_WAITALL) == sizeof(int);
+    });
+    if (!controlOk) {
+        throw std::runtime_error("建立多线程传输会话失败");
+    }
+
+    if (showProgress) {
+        std::cout << " 文件分块: " << totalChunks << " 个块, 块大小: " << chunkSize/1024 << " KB, "
+                  << "发送线程: " << (options.autoTuneStreams ? "自动, 最多 " : "") << workerCount << std::endl;
+        std::cout << " 会话ID: " << sessionId << std::endl;
+        std::cout << " 启动多线程传输..." << std::endl;
+    }
+
+    int skippedChunks = 0;
+    for (int i = 0; i < totalChunks; i++) {
+        if (journal.isDone(i)) {
+            skippedChunks++;
+            stats.completedChunks++;
+            stats.totalSent += std::min(chunkSize, fileSize - i * chunkSize);
         }
+    }
+    if (showProgress && skippedChunks > 0) {
+        std::cout << " 断点续传: 服务器已有 " << skippedChunks << "/" << totalChunks << " 个块" << std::endl;
+    }
 
-        int sessionId;
-        if (recv(controlSocket, &sessionId, sizeof(int), MSG_WAITALL) != sizeof(int)) {
-            close(controlSocket);
-            throw std::runtime_error("接收会话ID失败");
+    int dedupedChunks = 0;
+    if (protocolVersion >= 2 && (serverCapabilities & CAPABILITY_DEDUP) && options.deduplicate &&
+        skippedChunks < totalChunks) {
+        dedupedChunks = deduplicateChunks(filePath, sessionId, fileSize, chunkSize, totalChunks, workerCount,
+                                          journal, stats);
+        if (showProgress && dedupedChunks > 0) {
+            std::cout << " 去重: 服务器已有相同内容的 " << dedupedChunks << "/" << totalChunks
+                      << " 个块，无需发送" << std::endl;
         }
+    }
 
-        close(controlSocket);
+    std::vector<std::thread> threads;
+    chunkLatencyMs.assign(totalChunks, 0);
+    std::atomic<int> nextChunk{0};
+    std::deque<int> retryQueue;
+    std::vector<int> attempts(totalChunks, 0);
+    std::vector<uint32_t> chunkCrc(totalChunks, 0);
+    std::mutex errorMutex;
+    std::string errorMessage;
+
+    std::unique_ptr<StreamTuner> tuner;
+    if (options.autoTuneStreams) {
+        tuner = std::make_unique<StreamTuner>(remoteName, stats.totalSent, workerCount, options.tuningLogPath);
+    }
 
-        long chunkSize = fileSize / numThreads;
-        long lastChunkSize = fileSize - (chunkSize * (numThreads - 1));
+    for (int t = 0; t < workerCount; t++) {
+        threads.emplace_back([this, t, sessionId, chunkSize, totalChunks, fileSize, filePath, sparse, &stats,
+                              &nextChunk, &retryQueue, &attempts, &journal, &chunkLatencyMs, &chunkCrc, &errorMutex,
+                              &errorMessage, &tuner]() {
+            Trace::nameThread("upload-" + std::to_string(t));
+            bool warmedUp = false;
+            // 先完成的线程继续领取剩余块，慢连接只拖慢它自己手上的块
+            while (true) {
+                long long allocationsBefore = AllocationCounter::threadCount();
+                if (tuner) {
+                    tuner->waitForTurn(t);
+                }
+                int i;
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!errorMessage.empty()) {
+                        return;
+                    }
+                    if (!retryQueue.empty()) {
+                        i = retryQueue.front();
+                        retryQueue.pop_front();
+                    } else {
+                        i = nextChunk++;
+                    }
+                }
 
-        std::cout << " 文件分块: " << numThreads << " 个块, 块大小: ~" << chunkSize/1024 << " KB" << std::endl;
-        std::cout << " 会话ID: " << sessionId << std::endl;
-        std::cout << " 启动多线程传输..." << std::endl;
+                if (i >= totalChunks) {
+                    if (tuner) {
+                        tuner->finish();
+                    }
+                    return;
+                }
+                if (journal.isDone(i)) {
+                    continue;
+                }
 
-        std::vector<std::thread> threads;
-        std::vector<bool> threadSuccess(numThreads, true);
-        std::mutex errorMutex;
-        std::string errorMessage;
+                long startPos = i * chunkSize;
+                long currentChunkSize = std::min(chunkSize, fileSize - startPos);
+                auto chunkStart = std::chrono::steady_clock::now();
 
-        for (int i = 0; i < numThreads; i++) {
-            long startPos = i * chunkSize;
-            long currentChunkSize = (i == numThreads - 1) ? lastChunkSize : chunkSize;
-            
-            threads.emplace_back([this, i, sessionId, startPos, currentChunkSize, filePath, &stats, &threadSuccess, &errorMutex, &errorMessage]() {
                 try {
-                    sendChunk(i, sessionId, startPos, currentChunkSize, filePath, stats);
+                    chunkCrc[i] = sendChunk(i, sessionId, startPos, currentChunkSize, filePath, sparse, stats);
                 } catch (const std::exception& e) {
+                    // 连接中断或服务器校验失败时重新排队，服务器会话仍在等待该块
                     std::lock_guard<std::mutex> lock(errorMutex);
-                    threadSuccess[i] = false;
+                    if (++attempts[i] < MAX_CHUNK_ATTEMPTS) {
+                        Metrics::add(Counter::ChunkRetries);
+                        retryQueue.push_back(i);
+                        continue;
+                    }
                     errorMessage = e.what();
+                    if (tuner) {
+                        tuner->finish();
+                    }
+                    return;
                 }
-            });
-        }
 
-        bool allThreadsSuccess = true;
-        while (stats.completedChunks < numThreads) {
-            long currentSent = stats.totalSent;
-            double progress = (double)currentSent / fileSize * 100;
-            
-            auto currentTime = std::chrono::steady_clock::now();
-            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - startTime).count();
-            double speed = (duration > 0) ? (double)currentSent / duration / 1024 : 0;
-            
-            std::cout << " 进度: " << std::fixed << std::setprecision(1) << progress 
-                      << "%, 速度: " << std::setprecision(2) << speed << " KB/s, "
-                      << "完成块: " << stats.completedChunks << "/" << numThreads << "\r" << std::flush;
-            
-            {
-                std::lock_guard<std::mutex> lock(errorMutex);
-                if (!errorMessage.empty()) {
-                    allThreadsSuccess = false;
-                    break;
+                journal.markDone(i);
+                chunkLatencyMs[i] = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - chunkStart).count();
+
+                // 每个线程的第一块用于预热 (线程缓存、预读线程、复用的消息和区间表)，之后逐块计数
+                if (warmedUp) {
+                    hotPathAllocations += AllocationCounter::threadCount() - allocationsBefore + chunkReaderAllocations;
+                    hotPathChunks++;
                 }
+                warmedUp = true;
             }
-            
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
-        }
+        });
+    }
 
-        for (auto& thread : threads) {
-            if (thread.joinable()) {
-                thread.join();
+    while (showProgress && stats.completedChunks < totalChunks) {
+        long currentSent = stats.totalSent;
+        double progress = (double)currentSent / fileSize * 100;
+        
+        auto currentTime = std::chrono::steady_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - stats.startTime).count();
+        double speed = (duration > 0) ? (double)currentSent / duration / 1024 : 0;
+        
+        std::ostringstream line;
+        line << " 进度: " << std::fixed << std::setprecision(1) << progress
+             << "%, 速度: " << std::setprecision(2) << speed << " KB/s, "
+             << "完成块: " << stats.completedChunks << "/" << totalChunks;
+        Logger::progress(line.str());
+        
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!errorMessage.empty()) {
+                break;
             }
         }
+        
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
 
-        if (!allThreadsSuccess) {
-            throw std::runtime_error("多线程传输失败: " + errorMessage);
+    for (auto& thread : threads) {
+        if (thread.joinable()) {
+            thread.join();
         }
+    }
+    Logger::flush();
+    if (tuner) {
+        reportTuning(*tuner, showProgress);
+    }
 
-        auto endTime = std::chrono::steady_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
-        double avgSpeed = (duration > 0) ? (double)fileSize / duration / 1024 * 1000 : 0;
-        
-        std::cout << "\n 多线程传输完成!" << std::endl;
-        std::cout << "  传输耗时: " << duration << " ms" << std::endl;
-        std::cout << " 平均速度: " << std::fixed << std::setprecision(2) << avgSpeed << " KB/s" << std::endl;
+    if (!errorMessage.empty()) {
+        journal.sync();
+        throw std::runtime_error("多线程传输失败: " + errorMessage);
+    }
+
+    journal.remove();
+
+    // 各块的 CRC 按顺序合并为整个文件的 CRC，跳过的块不在本地重算，稀疏块只覆盖数据区
+    if (showProgress && sendsChecksums() && skippedChunks == 0 && dedupedChunks == 0 && !sparse) {
+        uint32_t fileCrc = chunkCrc[0];
+        for (int i = 1; i < totalChunks; i++) {
+            fileCrc = Checksum::crc32cCombine(fileCrc, chunkCrc[i], std::min(chunkSize, fileSize - i * chunkSize));
+        }
+        char crcText[16];
+        snprintf(crcText, sizeof(crcText), "%08x", fileCrc);
+        std::cout << "\n CRC32C: " << crcText << std::endl;
+    }
+}
+
+int TransferHandlers::deduplicateChunks(const std::string& filePath, int sessionId, long fileSize, long chunkSize,
+                                        int totalChunks, int workerCount, ResumeJournal& journal,
+                                        TransferStats& stats) {
+    std::vector<int> pending;
+    for (int i = 0; i < totalChunks; i++) {
+        if (!journal.isDone(i)) {
+            pending.push_back(i);
+        }
+    }
+
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
 
+    // 摘要计算与上传使用相同的并行度
+    std::vector<ChunkDigest> digests(pending.size());
+    std::vector<char> digestOk(pending.size(), 0);
+    std::atomic<size_t> nextDigest{0};
+    std::vector<std::thread> hashers;
+    for (int t = 0; t < workerCount; t++) {
+        hashers.emplace_back([&, fd]() {
+            size_t k;
+            while ((k = nextDigest++) < pending.size()) {
+                long startPos = pending[k] * chunkSize;
+                long length = std::min(chunkSize, fileSize - startPos);
+                digestOk[k] = ChunkDedup::digestFileRange(fd, startPos, length, digests[k]);
+            }
+        });
+    }
+    for (auto& hasher : hashers) {
+        hasher.join();
+    }
+    close(fd);
+
+    std::vector<std::pair<int, ChunkDigest>> query;
+    for (size_t k = 0; k < pending.size(); k++) {
+        if (digestOk[k]) {
+            query.emplace_back(pending[k], digests[k]);
+        }
+    }
+
+    std::vector<int> materialized;
+    try {
+        bool ok = controlRequest([&](int socket) {
+            return ChunkDedup::query(socket, static_cast<uint32_t>(sessionId), query, materialized);
+        });
+        if (!ok) {
+            std::cerr << " 去重查询失败，全部块照常上传" << std::endl;
+            return 0;
+        }
     } catch (const std::exception& e) {
-        std::cerr << "\n 多线程传输错误: " << e.what() << std::endl;
-        throw;
+        std::cerr << " 去重查询失败，全部块照常上传: " << e.what() << std::endl;
+        return 0;
+    }
+
+    int hits = 0;
+    for (int i : materialized) {
+        if (i < 0 || i >= totalChunks || journal.isDone(i)) {
+            continue;
+        }
+        long length = std::min(chunkSize, fileSize - i * chunkSize);
+        journal.markDone(i);
+        stats.completedChunks++;
+        stats.totalSent += length;
+        dedupBytesSaved += length;
+        hits++;
     }
+    dedupQueried += query.size();
+    dedupHits += hits;
+    return hits;
 }
 
-void TransferHandlers::sendChunk(int chunkIndex, int sessionId, long startPos, long chunkSize, 
-                              const std::string& filePath, TransferStats& stats) {
+uint32_t TransferHandlers::sendChunk(int chunkIndex, int sessionId, long startPos, long chunkSize, 
+                              const std::string& filePath, bool sparse, TransferStats& stats) {
     int chunkSocket = -1;
+    int fd = -1;
+    uint32_t crc = 0;
+    long long inFlight = 0;
+    long long counted = 0;      // 本次尝试计入 stats.totalSent 的字节，失败时扣回，重试会重新计入
+    MetricsTimer chunkTimer(Histogram::ChunkLatencyUs);
+    TraceSpan chunkSpan("chunk", "chunk ", chunkIndex);
+    chunkSpan.arg("chunk", chunkIndex);
+    chunkSpan.arg("offset", startPos);
+    chunkSpan.arg("bytes", chunkSize);
+    Metrics::adjust(Gauge::ChunksInFlight, 1);
+    // 压缩需要数据经过用户态，启用时不走 sendfile；稀疏块的空洞已不发送，不再压缩
+    bool compress = protocolVersion >= 2 && options.compression != CompressionMode::None && !sparse;
+    chunkReaderAllocations = 0;
     try {
-        chunkSocket = NetworkUtils::createConnection(serverIP, serverPort);
+        fd = open(filePath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("无法打开文件: " + filePath);
+        }
 
-        int header[4] = {sessionId, chunkIndex, static_cast<int>(startPos), static_cast<int>(chunkSize)};
-        ssize_t totalSent = 0;
-        while (totalSent < static_cast<ssize_t>(sizeof(header))) {
-            ssize_t sent = send(chunkSocket, reinterpret_cast<char*>(header) + totalSent, 
-                               sizeof(header) - totalSent, 0);
-            if (sent <= 0) {
-                throw std::runtime_error("发送块头信息失败");
-            }
-            totalSent += sent;
+        // 区间表、消息和预读流水线都按线程复用，预热后每块不再分配
+        thread_local std::vector<FileExtent> extents;
+        if (sparse) {
+            // 数据区多于预留个数的块会让区间表再扩容一次，之后同样复用
+            extents.reserve(SPARSE_EXTENT_RESERVE);
+            SparseFile::dataExtents(fd, startPos, chunkSize, extents);
+        } else {
+            extents.assign(1, FileExtent{startPos, chunkSize});
+        }
+        long long dataBytes = SparseFile::dataBytes(extents);
+
+        chunkSocket = acquireConnection();
+
+        TraceSpan sendSpan("chunk", "send");
+        thread_local WireMessage message;
+        bool headerSent = false;
+        if (protocolVersion >= 2) {
+            FrameType type = sparse ? FrameType::SparseChunk : (compress ? FrameType::CompressedChunk : FrameType::Chunk);
+            message.reset(type);
+            message.put(static_cast<uint32_t>(sessionId));
+            message.put(static_cast<uint32_t>(chunkIndex));
+            message.put(static_cast<uint64_t>(startPos));
+            message.put(static_cast<uint64_t>(chunkSize));
+            headerSent = message.sendAll(chunkSocket) && (!sparse || SparseFile::sendExtentMap(chunkSocket, extents));
+        } else {
+            int header[4] = {sessionId, chunkIndex, static_cast<int>(startPos), static_cast<int>(chunkSize)};
+            message.reset();
+            message.putNative(header);
+            headerSent = message.sendAll(chunkSocket);
         }
 
-        std::ifstream file(filePath, std::ios::binary);
-        if (!file.is_open()) {
-            throw std::runtime_error("无法打开文件: " + filePath);
+        if (!headerSent) {
+            throw std::runtime_error("发送块头信息失败");
         }
-        file.seekg(startPos);
 
-        std::vector<char> buffer(BUFFER_SIZE);
-        long sent = 0;
-        
-        while (sent < chunkSize) {
-            long remaining = chunkSize - sent;
-            long toRead = std::min(remaining, static_cast<long>(buffer.size()));
-            
-            file.read(buffer.data(), toRead);
-            int bytesRead = file.gcount();
-            
-            if (bytesRead > 0) {
-                ssize_t bytesSent = 0;
-                while (bytesSent < bytesRead) {
-                    ssize_t result = send(chunkSocket, buffer.data() + bytesSent, bytesRead - bytesSent, 0);
-                    if (result <= 0) {
+        if (usesZeroCopy() && !compress) {
+            bool zeroCopy = true;
+
+            for (const auto& extent : extents) {
+                long long sent = 0;
+                while (sent < extent.length) {
+                    long long toSend = std::min(ZERO_COPY_SLICE, extent.length - sent);
+                    long long bytesSent = NetworkUtils::sendFileRange(chunkSocket, fd, extent.offset + sent, toSend, zeroCopy);
+                    if (bytesSent <= 0) {
                         throw std::runtime_error("发送块数据失败");
                     }
-                    bytesSent += result;
+                    addInFlight(inFlight, bytesSent);
+                    sent += bytesSent;
+                    stats.totalSent += bytesSent;
+                    counted += bytesSent;
                 }
-                sent += bytesRead;
-                stats.totalSent += bytesRead;
-            } else {
-                break;
+            }
+
+            if (!zeroCopy) {
+                zeroCopyFallback = true;
+            }
+        } else {
+            // 缓冲区来自池，块之间复用，不再每块分配
+            PooledBuffer encoded;
+            if (compress) {
+                encoded = BufferPool::acquire(BlockEncoder::maxEncodedSize(READ_AHEAD_SLOT_SIZE));
+            }
+            BlockEncoder encoder(options.compression, &compressionStats);
+            long long sent = 0;
+            bool sendFailed = false;
+
+            {
+                // 读线程提前读入后续数据，本线程只负责校验、压缩和发送。读线程常驻，随发送线程退出
+                thread_local ReadAheadPipeline pipeline;
+                ReadAheadRound round(pipeline, fd, extents);
+                const char* data;
+                size_t bytesRead;
+                while (!sendFailed && pipeline.next(data, bytesRead)) {
+                    if (sendsChecksums()) {
+                        crc = updateChecksum(crc, data, bytesRead);
+                    }
+                    const char* payload = data;
+                    ssize_t payloadSize = bytesRead;
+                    if (compress) {
+                        payloadSize = encoder.encode(data, bytesRead, encoded.data());
+                        payload = encoded.data();
+                    }
+                    ssize_t bytesSent = 0;
+                    while (bytesSent < payloadSize) {
+                        ssize_t result = send(chunkSocket, payload + bytesSent, payloadSize - bytesSent, 0);
+                        if (result <= 0) {
+                            sendFailed = true;
+                            break;
+                        }
+                        Metrics::record(Histogram::SendBytes, result);
+                        bytesSent += result;
+                    }
+                    addInFlight(inFlight, bytesSent);
+                    sent += bytesRead;
+                    stats.totalSent += bytesRead;
+                    counted += bytesRead;
+                }
+                recordPipelineWait(pipeline);
+                // 读线程本轮的分配次数要等本轮结束后才确定
+                pipeline.finish();
+                chunkReaderAllocations = pipeline.readerAllocations();
+            }
+
+            if (sendFailed || sent != dataBytes) {
+                throw std::runtime_error(sendFailed ? "发送块数据失败" : "读取文件失败: " + filePath);
             }
         }
 
-        file.close();
+        close(fd);
+        fd = -1;
+        // 空洞部分计入进度
+        stats.totalSent += chunkSize - dataBytes;
+        counted += chunkSize - dataBytes;
+        sendSpan.end();
+
+        if (sendsChecksums()) {
+            message.reset(FrameType::ChunkChecksum);
+            message.put(crc);
+            if (!message.sendAll(chunkSocket)) {
+                throw std::runtime_error("发送块校验和失败");
+            }
+        }
         
+        TraceSpan ackSpan("chunk", "wait_ack");
         char ack;
         if (recv(chunkSocket, &ack, 1, 0) <= 0) {
             throw std::runtime_error("未收到服务器确认");
         }
-        
-        if (chunkSocket >= 0) {
-            close(chunkSocket);
-            chunkSocket = -1;
+        ackSpan.end();
+        if (protocolVersion >= 2 && ack != 'A') {
+            // 服务器计算的 CRC 与发送端不一致，丢弃该块等待重传
+            throw std::runtime_error("块校验失败");
         }
+        
+        releaseConnection(chunkSocket);
+        chunkSocket = -1;
+        Metrics::adjust(Gauge::BytesInFlight, -inFlight);
+        Metrics::adjust(Gauge::ChunksInFlight, -1);
+        Metrics::add(Counter::ChunksSent);
+        chunkTimer.stop();
 
         stats.completedChunks++;
         
-        {
-            std::lock_guard<std::mutex> lock(stats.consoleMutex);
-            std::cout << " 块 " << chunkIndex << " 传输完成 (" << chunkSize << " 字节)" << std::endl;
-        }
+        Logger::logf(LogLevel::Info, " 块 %d 传输完成 (%ld 字节)", chunkIndex, chunkSize);
+        return crc;
     } catch (const std::exception& e) {
+        if (fd >= 0) {
+            close(fd);
+        }
         if (chunkSocket >= 0) {
             close(chunkSocket);
         }
-        std::lock_guard<std::mutex> lock(stats.consoleMutex);
-        std::cerr << " 块 " << chunkIndex << " 错误: " << e.what() << std::endl;
+        stats.totalSent -= counted;
+        Metrics::adjust(Gauge::BytesInFlight, -inFlight);
+        Metrics::adjust(Gauge::ChunksInFlight, -1);
+        chunkSpan.arg("failed", 1);
+        Logger::error(" 块 " + std::to_string(chunkIndex) + " 错误: " + e.what());
         throw;
     }
 }
 
 void TransferHandlers::directoryTransfer(const std::string& dirPath) {
+    MetricsSession metricsSession(metrics.get(), "dir " + dirPath);
+    TraceSpan transferSpan("transfer", "dir " + dirPath);
     std::cout << " 启动文件夹传输模式..." << std::endl;
     
     auto startTime = std::chrono::steady_clock::now();
@@ -467,142 +1159,342 @@ void TransferHandlers::directoryTransfer(const std::string& dirPath) {
             dirName = dirName.substr(lastSlash + 1);
         }
 
-        std::cout << " 连接服务器 " << serverIP << ":" << serverPort << "..." << std::endl;
-        int controlSocket = NetworkUtils::createConnection(serverIP, serverPort);
-
-        char mode = 'D';
-        if (send(controlSocket, &mode, 1, 0) <= 0) {
-            close(controlSocket);
-            throw std::runtime_error("发送模式标识失败");
-        }
-
-        int baseNameLen = dirName.size();
-        if (send(controlSocket, &baseNameLen, sizeof(int), 0) <= 0) {
-            close(controlSocket);
-            throw std::runtime_error("发送基础目录名长度失败");
-        }
-        
-        if (send(controlSocket, dirName.c_str(), baseNameLen, 0) <= 0) {
-            close(controlSocket);
-            throw std::runtime_error("发送基础目录名失败");
+        negotiateProtocol();
+
+        DirectoryScanner scanner(dirPath, options.scanThreads);
+        DirectoryProgress progress;
+        ScanQueue dirQueue;
+        ScanQueue fileQueue;
+        ScanQueue largeQueue;
+        std::atomic<int> largeCount{0};
+
+        // 扫描结果按类型分发: 目录项一条流，小文件多条并行流共享一个队列，大文件按块上传
+        auto dispatch = [this, &progress, &dirQueue, &fileQueue, &largeQueue, &largeCount](ScanEntry&& entry) {
+            progress.totalItems++;
+            if (entry.isDirectory) {
+                dirQueue.push(std::move(entry));
+            } else if (entry.size >= options.largeFileThreshold) {
+                largeCount++;
+                largeQueue.push(std::move(entry));
+            } else {
+                fileQueue.push(std::move(entry));
+            }
+        };
+
+        // 增量同步需要完整清单，先扫描完再交换；否则边扫描边发送
+        std::vector<ScanEntry> scanned;
+        bool incremental = false;
+        if (options.syncMode != SyncMode::Full) {
+            if (protocolVersion >= 2 && (serverCapabilities & CAPABILITY_MANIFEST)) {
+                incremental = true;
+                std::mutex scannedMutex;
+                scanner.run([&scanned, &scannedMutex](ScanEntry&& entry) {
+                    std::lock_guard<std::mutex> lock(scannedMutex);
+                    scanned.push_back(std::move(entry));
+                });
+
+                size_t scannedItems = scanned.size();
+                int deletedCount = 0;
+                syncManifest(dirName, dirPath, scanned, deletedCount);
+                std::cout << " 增量同步: 本地 " << scannedItems << " 项, 需传输 " << scanned.size() << " 项";
+                if (options.syncMode == SyncMode::Mirror) {
+                    std::cout << ", 服务器删除 " << deletedCount << " 项";
+                }
+                std::cout << std::endl;
+
+                if (scanned.empty()) {
+                    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - startTime).count();
+                    std::cout << " 服务器端已是最新，无需传输" << std::endl;
+                    std::cout << "  同步耗时: " << duration << " ms" << std::endl;
+                    return;
+                }
+            } else {
+                std::cout << " 服务器不支持增量同步，传输全部内容" << std::endl;
+            }
         }
 
-        std::vector<std::pair<std::string, bool>> fileList;
-        scanDirectory(dirPath, "", fileList);
-        
-        int totalItems = fileList.size();
-        if (send(controlSocket, &totalItems, sizeof(int), 0) <= 0) {
-            close(controlSocket);
-            throw std::runtime_error("发送文件数量失败");
+        int streamCount = std::max(1, options.directoryStreams);
+        std::cout << " 连接服务器 " << serverIP << ":" << serverPort << "..." << std::endl;
+        std::cout << " 开始传输文件夹内容 (小文件分 " << streamCount << " 路并行)..." << std::endl;
+
+        // 发送流在扫描期间就开始工作，扫描结束后关闭队列
+        std::vector<std::thread> streams;
+        CreatedDirectories createdDirectories;
+        streams.emplace_back([this, &dirName, &dirPath, &dirQueue, &progress, &createdDirectories]() {
+            Trace::nameThread("dir-structure");
+            if (!sendDirectoryStream(dirName, dirPath, dirQueue, progress, &createdDirectories)) {
+                Logger::error("\n 目录结构流中断");
+            }
+            createdDirectories.finish();
+        });
+        for (int i = 0; i < streamCount; i++) {
+            streams.emplace_back([this, &dirName, &dirPath, &fileQueue, &progress, i]() {
+                Trace::nameThread("dir-stream-" + std::to_string(i));
+                if (!sendDirectoryStream(dirName, dirPath, fileQueue, progress, nullptr)) {
+                    Logger::error("\n 并行流 " + std::to_string(i) + " 中断");
+                }
+            });
         }
 
-        std::cout << " 发现 " << totalItems << " 个文件/目录" << std::endl;
-        std::cout << " 开始传输文件夹内容..." << std::endl;
-
-        int successCount = 0;
-        int failCount = 0;
-
-        for (size_t i = 0; i < fileList.size(); i++) {
-            const auto& item = fileList[i];
-            std::string fullPath = dirPath + "/" + item.first;
-            
-            bool success = false;
-            if (item.second) {
-                success = sendDirectoryItem(controlSocket, item.first, fullPath);
-            } else {
-                success = sendDirectoryFile(controlSocket, item.first, fullPath);
+        // 大文件与小文件流并发，按多线程模式分块上传
+        // 分块会话不会创建父目录，每个大文件等它所在的目录建好后再上传
+        streams.emplace_back([this, &dirName, &dirPath, &largeQueue, &progress, &createdDirectories]() {
+            Trace::nameThread("dir-large-files");
+            std::vector<ScanEntry> files;
+            while (largeQueue.popBatch(files, 1) > 0) {
+                for (const auto& file : files) {
+                    size_t slash = file.path.find_last_of('/');
+                    createdDirectories.waitFor(slash == std::string::npos ? std::string() : file.path.substr(0, slash));
+                    std::string fullPath = dirPath + "/" + file.path;
+                    try {
+                        FileAttributes attrs = NetworkUtils::getFileAttributes(fullPath);
+                        TransferStats stats;
+                        stats.startTime = std::chrono::steady_clock::now();
+                        stats.fileSize = file.size;
+                        std::vector<double> chunkLatencyMs;
+                        uploadChunked(fullPath, dirName + "/" + file.path, attrs, file.size,
+                                      options.directoryStreams, stats, chunkLatencyMs, false);
+                        progress.successCount++;
+                    } catch (const std::exception& e) {
+                        progress.failCount++;
+                        Logger::error("\n 大文件传输失败: " + file.path + ": " + e.what());
+                    }
+                    reportDirectoryProgress(progress);
+                }
             }
+        });
 
-            if (success) {
-                successCount++;
-            } else {
-                failCount++;
+        if (incremental) {
+            for (auto& entry : scanned) {
+                dispatch(std::move(entry));
             }
-
-            std::cout << " 进度: " << (i+1) << "/" << totalItems 
-                      << " (成功: " << successCount << ", 失败: " << failCount << ")\r" << std::flush;
+        } else {
+            scanner.run(dispatch);
         }
+        dirQueue.close();
+        fileQueue.close();
+        largeQueue.close();
 
-        char response[1024];
-        int bytesReceived = recv(controlSocket, response, sizeof(response) - 1, 0);
-        if (bytesReceived > 0) {
-            response[bytesReceived] = '\0';
-            std::cout << "\n " << response << std::endl;
+        auto scanDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - startTime).count();
+        Logger::info("\n 扫描完成: " + std::to_string(progress.totalItems) + " 个文件/目录 (大文件 " +
+                     std::to_string(largeCount) + " 个分块传输), 耗时 " + std::to_string(scanDuration) + " ms");
+
+        for (auto& stream : streams) {
+            stream.join();
         }
+        reportDirectoryProgress(progress, true);
+        Logger::flush();
 
-        close(controlSocket);
+        // 中断流中未发出的项也计为失败
+        int totalItems = progress.totalItems;
+        int successCount = progress.successCount;
+        int failCount = totalItems - successCount;
+        std::cout << std::endl;
 
         auto endTime = std::chrono::steady_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
         
+        double filesPerSecond = (duration > 0) ? (double)successCount / duration * 1000 : 0;
+        
         std::cout << "  传输耗时: " << duration << " ms" << std::endl;
         std::cout << " 统计: 成功 " << successCount << " 个, 失败 " << failCount << " 个" << std::endl;
+        std::cout << " 文件速率: " << std::fixed << std::setprecision(1) << filesPerSecond << " 个/秒" << std::endl;
+        reportCompressionStats(duration);
+        reportDedupStats();
 
     } catch (const std::exception& e) {
+        Logger::flush();
         std::cerr << "\n 文件夹传输错误: " << e.what() << std::endl;
         throw;
     }
 }
 
-void TransferHandlers::scanDirectory(const std::string& basePath, const std::string& relativePath, 
-                                  std::vector<std::pair<std::string, bool>>& result) {
-    std::string fullPath = basePath;
-    if (!relativePath.empty()) {
-        fullPath += "/" + relativePath;
+// 只保留服务器回复需要的项
+void TransferHandlers::syncManifest(const std::string& dirName, const std::string& dirPath,
+                                    std::vector<ScanEntry>& entries, int& deletedCount) {
+    std::vector<ManifestEntry> manifest = DirectoryManifest::build(dirPath, entries, options.manifestDigests);
+
+    std::vector<int> needed;
+    bool exchanged = controlRequest([&](int socket) {
+        return DirectoryManifest::exchange(socket, dirName, manifest, options.syncMode == SyncMode::Mirror,
+                                           needed, deletedCount);
+    });
+    if (!exchanged) {
+        throw std::runtime_error("交换目录清单失败");
     }
 
-    DIR* dir = opendir(fullPath.c_str());
-    if (!dir) {
-        std::cerr << "无法打开目录: " << fullPath << std::endl;
-        return;
+    std::vector<ScanEntry> neededEntries;
+    neededEntries.reserve(needed.size());
+    for (int index : needed) {
+        neededEntries.push_back(std::move(entries[index]));
     }
+    entries.swap(neededEntries);
+}
 
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
+// 服务器按目录头中的项数接收，发送方按轮从队列取项，每轮一条连接。
+// 某一轮失败时继续取后续各轮，队列不会因无人消费而阻塞扫描线程。
+bool TransferHandlers::sendDirectoryStream(const std::string& dirName, const std::string& dirPath, ScanQueue& queue,
+                                           DirectoryProgress& progress, CreatedDirectories* createdDirectories) {
+    bool allSent = true;
+    bool pendingRoot = createdDirectories != nullptr;  // 空目录树也要在服务器上建出根目录
+    std::vector<ScanEntry> items;
+    std::vector<std::string> directories;
+    while (queue.popBatch(items, DIRECTORY_ROUND_ITEMS) > 0 || pendingRoot) {
+        pendingRoot = false;
+        bool roundSent = false;
+        try {
+            roundSent = sendDirectoryRound(dirName, dirPath, items, progress);
+        } catch (const std::exception&) {
         }
-
-        std::string itemRelativePath = relativePath.empty() ? 
-            entry->d_name : relativePath + "/" + entry->d_name;
-        
-        std::string itemFullPath = fullPath + "/" + entry->d_name;
-        
-        struct stat statBuf;
-        if (stat(itemFullPath.c_str(), &statBuf) == 0) {
-            if (S_ISDIR(statBuf.st_mode)) {
-                result.emplace_back(itemRelativePath, true);
-                scanDirectory(basePath, itemRelativePath, result);
-            } else {
-                result.emplace_back(itemRelativePath, false);
+        if (!roundSent) {
+            allSent = false;
+        } else if (createdDirectories) {
+            // 每轮的目录头都会建出根目录
+            directories.assign(1, std::string());
+            for (const auto& item : items) {
+                if (item.isDirectory) {
+                    directories.push_back(item.path);
+                }
             }
+            createdDirectories->add(directories);
         }
     }
-    closedir(dir);
+    return allSent;
 }
 
-bool TransferHandlers::sendDirectoryItem(int socket, const std::string& relativePath, const std::string& fullPath) {
-    try {
-        char itemType = 'D';
-        if (send(socket, &itemType, 1, 0) <= 0) {
-            return false;
+bool TransferHandlers::sendDirectoryRound(const std::string& dirName, const std::string& dirPath,
+                                          const std::vector<ScanEntry>& items, DirectoryProgress& progress) {
+    TraceSpan roundSpan("directory", "round");
+    roundSpan.arg("items", static_cast<long long>(items.size()));
+
+    // 目录头中的项数发出后不能再改，先去掉打不开的项，不计入本轮
+    std::vector<const ScanEntry*> sendable;
+    sendable.reserve(items.size());
+    for (const auto& item : items) {
+        if (entryReadable(dirPath + "/" + item.path, item.isDirectory)) {
+            sendable.push_back(&item);
+        } else {
+            progress.failCount++;
         }
+    }
 
-        int pathLen = relativePath.size();
-        if (send(socket, &pathLen, sizeof(int), 0) <= 0) {
+    int controlSocket = acquireConnection();
+
+    int itemCount = sendable.size();
+    bool headerSent = false;
+    if (protocolVersion >= 2) {
+        WireMessage header(FrameType::Directory);
+        header.putString(dirName);
+        header.put(static_cast<uint32_t>(itemCount));
+        headerSent = header.sendAll(controlSocket);
+    } else {
+        WireMessage header;
+        header.putNative('D');
+        header.putNative(static_cast<int>(dirName.size()));
+        header.putBytes(dirName.data(), dirName.size());
+        header.putNative(itemCount);
+        headerSent = header.sendAll(controlSocket);
+    }
+
+    if (!headerSent) {
+        close(controlSocket);
+        progress.failCount += itemCount;
+        return false;
+    }
+
+    FileBatch batch(protocolVersion, options.packBatchSize, options.packFileThreshold,
+                    options.compression, &compressionStats);
+    auto flushBatch = [&batch, &progress, controlSocket]() {
+        int packed = batch.size();
+        if (!batch.flush(controlSocket)) {
+            progress.failCount += packed;
             return false;
         }
+        progress.successCount += packed;
+        Metrics::add(Counter::FilesSent, packed);
+        return true;
+    };
+    // 预检之后仍可能有项发不出 (文件被删除或截断)，此时服务器还在等剩余的项。
+    // 直接关闭连接让服务器立即结束本轮，而不是等到接收超时；未发出的项计为失败
+    auto abortRound = [this, &batch, &progress, controlSocket](size_t unsent) {
+        progress.failCount += unsent + batch.size();
+        close(controlSocket);
+        reportDirectoryProgress(progress);
+        return false;
+    };
+
+    for (size_t i = 0; i < sendable.size(); i++) {
+        const ScanEntry& item = *sendable[i];
+        std::string fullPath = dirPath + "/" + item.path;
+
+        // 小文件先攒进批记录，攒满后一次写出
+        if (!item.isDirectory && options.packSmallFiles) {
+            BatchResult result = batch.add(item.path, fullPath);
+            if (result == BatchResult::Added) {
+                if (batch.full()) {
+                    if (!flushBatch()) {
+                        return abortRound(sendable.size() - i - 1);
+                    }
+                    reportDirectoryProgress(progress);
+                }
+                continue;
+            }
+            if (result == BatchResult::Failed) {
+                return abortRound(sendable.size() - i);
+            }
+        }
 
-        if (send(socket, relativePath.c_str(), pathLen, 0) <= 0) {
-            return false;
+        // 保持服务器端的接收顺序
+        if (!flushBatch()) {
+            return abortRound(sendable.size() - i);
         }
 
-        FileAttributes attrs = NetworkUtils::getFileAttributes(fullPath);
-        if (send(socket, &attrs, sizeof(FileAttributes), 0) <= 0) {
-            return false;
+        bool success = false;
+        if (item.isDirectory) {
+            success = sendDirectoryItem(controlSocket, item.path, fullPath);
+        } else {
+            success = sendDirectoryFile(controlSocket, item.path, fullPath);
+            if (success) {
+                Metrics::add(Counter::FilesSent);
+            }
         }
 
-        return true;
+        if (!success) {
+            return abortRound(sendable.size() - i);
+        }
+        progress.successCount++;
+        reportDirectoryProgress(progress);
+    }
+
+    if (!flushBatch()) {
+        close(controlSocket);
+        return false;
+    }
+    reportDirectoryProgress(progress);
+
+    // 等待服务器确认本条流已全部落盘
+    char response[1024];
+    bool confirmed = recv(controlSocket, response, sizeof(response) - 1, 0) > 0;
+    close(controlSocket);
+    return confirmed;
+}
+
+// 每个文件完成后都会调用，按固定间隔输出
+void TransferHandlers::reportDirectoryProgress(DirectoryProgress& progress, bool final) {
+    if (!final && !progress.throttle.due()) {
+        return;
+    }
+    Logger::progress(" 进度: " + std::to_string(progress.successCount + progress.failCount) + "/" +
+                     std::to_string(progress.totalItems) + " (成功: " + std::to_string(progress.successCount) +
+                     ", 失败: " + std::to_string(progress.failCount) + ")");
+}
+
+bool TransferHandlers::sendDirectoryItem(int socket, const std::string& relativePath, const std::string& fullPath) {
+    try {
+        FileAttributes attrs = NetworkUtils::getFileAttributes(fullPath);
+        return sendDirectoryEntryHeader(socket, 'D', relativePath, attrs, 0);
     } catch (...) {
         return false;
     }
@@ -610,24 +1502,7 @@ bool TransferHandlers::sendDirectoryItem(int socket, const std::string& relative
 
 bool TransferHandlers::sendDirectoryFile(int socket, const std::string& relativePath, const std::string& fullPath) {
     try {
-        char itemType = 'F';
-        if (send(socket, &itemType, 1, 0) <= 0) {
-            return false;
-        }
-
-        int pathLen = relativePath.size();
-        if (send(socket, &pathLen, sizeof(int), 0) <= 0) {
-            return false;
-        }
-
-        if (send(socket, relativePath.c_str(), pathLen, 0) <= 0) {
-            return false;
-        }
-
         FileAttributes attrs = NetworkUtils::getFileAttributes(fullPath);
-        if (send(socket, &attrs, sizeof(FileAttributes), 0) <= 0) {
-            return false;
-        }
 
         struct stat fileStat;
         if (stat(fullPath.c_str(), &fileStat) != 0) {
@@ -635,41 +1510,867 @@ bool TransferHandlers::sendDirectoryFile(int socket, const std::string& relative
         }
 
         long long fileSize = fileStat.st_size;
-        if (send(socket, &fileSize, sizeof(long long), 0) <= 0) {
+        int fd = open(fullPath.c_str(), O_RDONLY);
+        if (fd < 0) {
             return false;
         }
 
-        std::ifstream file(fullPath, std::ios::binary);
-        if (!file.is_open()) {
+        // 'Z': 与 'F' 相同的头，内容为压缩块流
+        // 'S': 与 'F' 相同的头，随后一个 ExtentMap 帧，内容只有数据区
+        bool sparse = protocolVersion >= 2 && options.sparseFiles && SparseFile::isSparse(fileStat);
+        bool compress = protocolVersion >= 2 && options.compression != CompressionMode::None && !sparse;
+        std::vector<FileExtent> extents{{0, fileSize}};
+        if (sparse) {
+            extents = SparseFile::dataExtents(fd, 0, fileSize);
+        }
+
+        char itemType = sparse ? 'S' : (compress ? 'Z' : 'F');
+        if (!sendDirectoryEntryHeader(socket, itemType, relativePath, attrs, fileSize) ||
+            (sparse && !SparseFile::sendExtentMap(socket, extents))) {
+            close(fd);
             return false;
         }
 
-        std::vector<char> buffer(BUFFER_SIZE);
+        PooledBuffer buffer = BufferPool::acquire(BUFFER_SIZE);
+        PooledBuffer encoded;
+        if (compress) {
+            encoded = BufferPool::acquire(BlockEncoder::maxEncodedSize(BUFFER_SIZE));
+        }
+        BlockEncoder encoder(options.compression, &compressionStats);
         long long sent = 0;
         
-        while (sent < fileSize) {
-            file.read(buffer.data(), buffer.size());
-            int bytesRead = file.gcount();
-            
-            if (bytesRead > 0) {
-                int bytesSent = 0;
-                while (bytesSent < bytesRead) {
-                    int result = send(socket, buffer.data() + bytesSent, bytesRead - bytesSent, 0);
+        for (const auto& extent : extents) {
+            long long extentSent = 0;
+            while (extentSent < extent.length) {
+                ssize_t bytesRead = pread(fd, buffer.data(),
+                                          std::min(static_cast<long long>(BUFFER_SIZE), extent.length - extentSent),
+                                          extent.offset + extentSent);
+                if (bytesRead < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (bytesRead <= 0) {
+                    break;
+                }
+
+                const char* payload = buffer.data();
+                ssize_t payloadSize = bytesRead;
+                if (compress) {
+                    payloadSize = encoder.encode(buffer.data(), bytesRead, encoded.data());
+                    payload = encoded.data();
+                }
+                ssize_t bytesSent = 0;
+                while (bytesSent < payloadSize) {
+                    ssize_t result = send(socket, payload + bytesSent, payloadSize - bytesSent, 0);
                     if (result <= 0) {
-                        file.close();
+                        close(fd);
                         return false;
                     }
+                    Metrics::record(Histogram::SendBytes, result);
                     bytesSent += result;
                 }
-                sent += bytesRead;
-            } else {
+                extentSent += bytesRead;
+            }
+            if (extentSent != extent.length) {
                 break;
             }
+            sent += extentSent;
         }
 
-        file.close();
-        return sent == fileSize;
+        close(fd);
+        return sent == SparseFile::dataBytes(extents);
     } catch (...) {
         return false;
     }
+}
+
+namespace {
+
+RemoteFileInfo remoteInfoFromEntry(const ManifestEntry& entry) {
+    RemoteFileInfo info;
+    info.fileSize = entry.size;
+    info.attrs.permissions = entry.mode;
+    info.attrs.modify_time.tv_sec = entry.mtimeSec;
+    info.attrs.modify_time.tv_nsec = entry.mtimeNsec;
+    info.attrs.access_time = info.attrs.modify_time;
+    return info;
+}
+
+// 服务器给出的相对路径不能是绝对路径，也不能用 ".." 跳出目标目录
+bool isSafeRelativePath(const std::string& path) {
+    return !path.empty() && path[0] != '/' && ("/" + path + "/").find("/../") == std::string::npos;
+}
+
+} // namespace
+
+void TransferHandlers::requireDownloadSupport() {
+    negotiateProtocol();
+    if (protocolVersion < 2 || !(serverCapabilities & CAPABILITY_DOWNLOAD)) {
+        throw std::runtime_error("服务器不支持下载");
+    }
+}
+
+void TransferHandlers::downloadFile(const std::string& remotePath, const std::string& localDir, int numThreads) {
+    MetricsSession metricsSession(metrics.get(), "get " + remotePath);
+    TraceSpan transferSpan("transfer", "get " + remotePath);
+    std::cout << " 启动" << (numThreads > 1 ? "多线程" : "顺序") << "下载模式..." << std::endl;
+
+    auto startTime = std::chrono::steady_clock::now();
+    double cpuStart = NetworkUtils::processCpuSeconds();
+    TransferStats stats;
+    stats.startTime = startTime;
+
+    try {
+        std::string fileName = remotePath;
+        size_t lastSlash = fileName.find_last_of("/\\");
+        if (lastSlash != std::string::npos) {
+            fileName = fileName.substr(lastSlash + 1);
+        }
+        if (fileName.empty() || fileName == "." || fileName == "..") {
+            throw std::runtime_error("无效的文件路径: " + remotePath);
+        }
+
+        requireDownloadSupport();
+
+        RemoteFileInfo remote;
+        long long dataLength = 0;
+        int socket = acquireConnection();
+        bool found = false;
+        try {
+            found = requestRemoteFile(socket, remotePath, 0, 0, remote, dataLength);
+        } catch (...) {
+            close(socket);
+            throw;
+        }
+        releaseConnection(socket);
+        if (!found) {
+            throw std::runtime_error("服务器上找不到文件: " + remotePath);
+        }
+
+        std::string localPath = localDir + "/" + fileName;
+        NetworkUtils::displayFileAttributes(remotePath, remote.attrs, remote.fileSize);
+        stats.fileSize = remote.fileSize;
+
+        downloadChunked(remotePath, localPath, remote, numThreads, stats, true);
+
+        auto endTime = std::chrono::steady_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+        double avgSpeed = (duration > 0) ? (double)remote.fileSize / duration / 1024 * 1000 : 0;
+
+        std::cout << "\n 下载完成: " << localPath << std::endl;
+        std::cout << "  传输耗时: " << duration << " ms" << std::endl;
+        std::cout << " 平均速度: " << std::fixed << std::setprecision(2) << avgSpeed << " KB/s" << std::endl;
+        reportEngineStats(remote.fileSize, cpuStart);
+
+    } catch (const std::exception& e) {
+        Logger::flush();
+        std::cerr << "\n 下载错误: " << e.what() << std::endl;
+        throw;
+    }
+}
+
+// 请求 [offset, offset + length) 范围，length 为 0 时只取文件信息。
+// 数据紧随 DownloadInfo 帧之后，服务器直接 sendfile() 发出；同一连接可连续请求多个范围。
+bool TransferHandlers::requestRemoteFile(int socket, const std::string& remotePath, long long offset,
+                                         long long length, RemoteFileInfo& info, long long& dataLength) {
+    WireMessage request(FrameType::DownloadRequest);
+    request.putString(remotePath);
+    request.put(static_cast<uint64_t>(offset));
+    request.put(static_cast<uint64_t>(length));
+    request.put(static_cast<uint8_t>(options.verifyChecksums && length > 0 ? DOWNLOAD_FLAG_CHECKSUM : 0));
+
+    std::vector<char> payload;
+    if (!request.sendAll(socket) || !WireReader::recvFrame(socket, FrameType::DownloadInfo, payload)) {
+        throw std::runtime_error("请求下载失败");
+    }
+
+    WireReader reader(payload);
+    uint8_t status = reader.get<uint8_t>();
+    info.fileSize = static_cast<long long>(reader.get<uint64_t>());
+    info.attrs = reader.getAttributes();
+    dataLength = static_cast<long long>(reader.get<uint64_t>());
+    if (!reader.ok()) {
+        throw std::runtime_error("下载响应格式错误");
+    }
+    return status == 0;
+}
+
+void TransferHandlers::downloadChunked(const std::string& remotePath, const std::string& localPath,
+                                       const RemoteFileInfo& remote, int numThreads, TransferStats& stats,
+                                       bool showProgress) {
+    long long fileSize = remote.fileSize;
+    long long chunkSize = transferChunkSize(fileSize);
+    int totalChunks = static_cast<int>((fileSize + chunkSize - 1) / chunkSize);
+
+    // 与上传相同的断点日志，记录已写入本地的块；数据先写入 .part 文件，全部完成后改名
+    std::string partPath = localPath + ".part";
+    ResumeJournal journal;
+    std::string transferKey = "download|" + serverIP + ":" + std::to_string(serverPort) + "|" + remotePath + "|" +
+                              std::to_string(fileSize) + "|" + std::to_string(remote.attrs.modify_time.tv_sec) + "|" +
+                              std::to_string(chunkSize);
+    bool resuming = journal.open(transferKey, totalChunks) && journal.completedCount() > 0;
+    struct stat partStat;
+    if (resuming && (stat(partPath.c_str(), &partStat) != 0 || partStat.st_size != fileSize)) {
+        journal.reset();
+        resuming = false;
+    }
+
+    int fd = open(partPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | (resuming ? 0 : O_TRUNC), 0644);
+    if (fd < 0) {
+        throw std::runtime_error("无法创建文件: " + partPath);
+    }
+    // 预先设定文件大小，各块按偏移直接 pwrite()
+    if (!resuming && ftruncate(fd, fileSize) != 0) {
+        close(fd);
+        throw std::runtime_error("无法设置文件大小: " + partPath);
+    }
+
+    int skippedChunks = 0;
+    for (int i = 0; i < totalChunks; i++) {
+        if (journal.isDone(i)) {
+            skippedChunks++;
+            stats.completedChunks++;
+            stats.totalSent += std::min(chunkSize, fileSize - i * chunkSize);
+        }
+    }
+
+    int workerCount = std::max(1, std::min(options.autoTuneStreams ? MAX_THREADS : numThreads,
+                                           totalChunks - skippedChunks));
+    if (showProgress) {
+        if (skippedChunks > 0) {
+            std::cout << " 断点续传: 本地已有 " << skippedChunks << "/" << totalChunks << " 个块" << std::endl;
+        }
+        std::cout << " 文件分块: " << totalChunks << " 个块, 块大小: " << chunkSize/1024 << " KB, "
+                  << "接收线程: " << (options.autoTuneStreams ? "自动, 最多 " : "") << workerCount << std::endl;
+    }
+
+    std::vector<std::thread> threads;
+    std::atomic<int> nextChunk{0};
+    std::deque<int> retryQueue;
+    std::vector<int> attempts(totalChunks, 0);
+    std::mutex errorMutex;
+    std::string errorMessage;
+
+    std::unique_ptr<StreamTuner> tuner;
+    if (options.autoTuneStreams) {
+        tuner = std::make_unique<StreamTuner>(remotePath, stats.totalSent, workerCount, options.tuningLogPath);
+    }
+
+    for (int t = 0; t < workerCount; t++) {
+        threads.emplace_back([this, t, &remotePath, &remote, fd, chunkSize, totalChunks, fileSize, &stats, &journal,
+                              &nextChunk, &retryQueue, &attempts, &errorMutex, &errorMessage, &tuner]() {
+            Trace::nameThread("download-" + std::to_string(t));
+            // 每个线程一条连接，在连接上依次请求领到的块；顺序下载就是只有一个线程
+            int socket = -1;
+            while (true) {
+                if (tuner && t >= tuner->streams()) {
+                    // 暂停的流先把连接还回池中
+                    releaseConnection(socket);
+                    socket = -1;
+                    tuner->waitForTurn(t);
+                }
+                int i;
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!errorMessage.empty()) {
+                        break;
+                    }
+                    if (!retryQueue.empty()) {
+                        i = retryQueue.front();
+                        retryQueue.pop_front();
+                    } else {
+                        i = nextChunk++;
+                    }
+                }
+
+                if (i >= totalChunks) {
+                    break;
+                }
+                if (journal.isDone(i)) {
+                    continue;
+                }
+
+                long long startPos = i * chunkSize;
+                long long length = std::min(chunkSize, fileSize - startPos);
+
+                try {
+                    if (socket < 0) {
+                        socket = acquireConnection();
+                    }
+                    receiveRange(socket, fd, remotePath, remote, startPos, length, stats);
+                    // 块数据落盘后才记入日志，崩溃后不会把没写完的块当作已完成
+                    fdatasync(fd);
+                } catch (const std::exception& e) {
+                    if (socket >= 0) {
+                        close(socket);
+                        socket = -1;
+                    }
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (++attempts[i] < MAX_CHUNK_ATTEMPTS) {
+                        Metrics::add(Counter::ChunkRetries);
+                        retryQueue.push_back(i);
+                        continue;
+                    }
+                    errorMessage = e.what();
+                    break;
+                }
+
+                journal.markDone(i);
+                stats.completedChunks++;
+            }
+            if (tuner) {
+                tuner->finish();
+            }
+            releaseConnection(socket);
+        });
+    }
+
+    while (showProgress && stats.completedChunks < totalChunks) {
+        long currentSent = stats.totalSent;
+        double progress = (double)currentSent / fileSize * 100;
+
+        auto currentTime = std::chrono::steady_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - stats.startTime).count();
+        double speed = (duration > 0) ? (double)currentSent / duration / 1024 : 0;
+
+        std::ostringstream line;
+        line << " 进度: " << std::fixed << std::setprecision(1) << progress
+             << "%, 速度: " << std::setprecision(2) << speed << " KB/s, "
+             << "完成块: " << stats.completedChunks << "/" << totalChunks;
+        Logger::progress(line.str());
+
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!errorMessage.empty()) {
+                break;
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    Logger::flush();
+    close(fd);
+    if (tuner) {
+        reportTuning(*tuner, showProgress);
+    }
+
+    if (!errorMessage.empty()) {
+        journal.sync();
+        throw std::runtime_error("下载失败: " + errorMessage);
+    }
+
+    if (rename(partPath.c_str(), localPath.c_str()) != 0) {
+        throw std::runtime_error("无法重命名文件: " + partPath);
+    }
+    NetworkUtils::applyFileAttributes(localPath, remote.attrs);
+    journal.remove();
+}
+
+uint32_t TransferHandlers::receiveRange(int socket, int fd, const std::string& remotePath,
+                                        const RemoteFileInfo& remote, long long offset, long long length,
+                                        TransferStats& stats) {
+    MetricsTimer rangeTimer(Histogram::ChunkLatencyUs);
+    TraceSpan rangeSpan("chunk", "range");
+    rangeSpan.arg("offset", offset);
+    rangeSpan.arg("bytes", length);
+    RemoteFileInfo current;
+    long long dataLength = 0;
+    TraceSpan requestSpan("chunk", "request");
+    if (!requestRemoteFile(socket, remotePath, offset, length, current, dataLength)) {
+        throw std::runtime_error("服务器上找不到文件: " + remotePath);
+    }
+    requestSpan.end();
+    // 下载期间服务器上的文件被修改，已下载的部分不能再和新内容拼接
+    if (current.fileSize != remote.fileSize ||
+        current.attrs.modify_time.tv_sec != remote.attrs.modify_time.tv_sec ||
+        current.attrs.modify_time.tv_nsec != remote.attrs.modify_time.tv_nsec) {
+        throw std::runtime_error("服务器上的文件已改变: " + remotePath);
+    }
+    if (dataLength != length) {
+        throw std::runtime_error("服务器返回的数据长度不符: " + remotePath);
+    }
+
+    PooledBuffer buffer = BufferPool::acquire(READ_AHEAD_SLOT_SIZE);
+    uint32_t crc = 0;
+    long long received = 0;
+    // 失败时扣回本次计入进度的字节，重试会重新计入
+    try {
+        TraceSpan receiveSpan("chunk", "receive");
+        while (received < length) {
+            ssize_t bytesRead = recv(socket, buffer.data(),
+                                     std::min(static_cast<long long>(buffer.capacity()), length - received), 0);
+            if (bytesRead < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytesRead <= 0) {
+                throw std::runtime_error("接收数据失败");
+            }
+            Metrics::record(Histogram::RecvBytes, bytesRead);
+
+            ssize_t written = 0;
+            while (written < bytesRead) {
+                MetricsTimer writeTimer(Histogram::DiskWriteUs);
+                ssize_t result = pwrite(fd, buffer.data() + written, bytesRead - written, offset + received + written);
+                writeTimer.stop();
+                if (result < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (result <= 0) {
+                    throw std::runtime_error("写入文件失败");
+                }
+                written += result;
+            }
+
+            if (options.verifyChecksums) {
+                crc = updateChecksum(crc, buffer.data(), bytesRead);
+            }
+            received += bytesRead;
+            stats.totalSent += bytesRead;
+        }
+
+        receiveSpan.end();
+
+        if (options.verifyChecksums && length > 0) {
+            TraceSpan checksumSpan("chunk", "wait_checksum");
+            std::vector<char> payload;
+            if (!WireReader::recvFrame(socket, FrameType::ChunkChecksum, payload)) {
+                throw std::runtime_error("接收校验和失败");
+            }
+            WireReader reader(payload);
+            uint32_t expected = reader.get<uint32_t>();
+            if (!reader.ok() || expected != crc) {
+                throw std::runtime_error("数据校验失败: " + remotePath);
+            }
+        }
+    } catch (...) {
+        stats.totalSent -= received;
+        throw;
+    }
+    rangeTimer.stop();
+    Metrics::add(Counter::ChunksReceived);
+    return crc;
+}
+
+void TransferHandlers::downloadDirectory(const std::string& remoteDir, const std::string& localDir) {
+    MetricsSession metricsSession(metrics.get(), "getdir " + remoteDir);
+    TraceSpan transferSpan("transfer", "getdir " + remoteDir);
+    std::cout << " 启动文件夹下载模式..." << std::endl;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    try {
+        std::string dirName = remoteDir;
+        while (dirName.size() > 1 && dirName.back() == '/') {
+            dirName.pop_back();
+        }
+        size_t lastSlash = dirName.find_last_of("/\\");
+        if (lastSlash != std::string::npos) {
+            dirName = dirName.substr(lastSlash + 1);
+        }
+        if (dirName.empty() || dirName == "." || dirName == "..") {
+            throw std::runtime_error("无效的文件夹路径: " + remoteDir);
+        }
+
+        requireDownloadSupport();
+
+        std::vector<ManifestEntry> entries;
+        bool listed = controlRequest([&](int socket) {
+            return DirectoryManifest::requestListing(socket, remoteDir, entries);
+        });
+        if (!listed) {
+            throw std::runtime_error("获取服务器目录列表失败: " + remoteDir);
+        }
+
+        std::string localRoot = localDir + "/" + dirName;
+        if (mkdir(localRoot.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::runtime_error("无法创建目录: " + localRoot);
+        }
+
+        DirectoryProgress progress;
+        std::vector<const ManifestEntry*> directories;
+        std::vector<const ManifestEntry*> smallFiles;
+        std::vector<const ManifestEntry*> largeFiles;
+        int skippedFiles = 0;
+        for (const auto& entry : entries) {
+            if (!isSafeRelativePath(entry.path)) {
+                progress.failCount++;
+                std::cerr << " 跳过不安全的路径: " << entry.path << std::endl;
+                continue;
+            }
+            if (entry.isDirectory) {
+                directories.push_back(&entry);
+                continue;
+            }
+            // 大小和修改时间都一致的文件在之前的下载中已经完成
+            struct stat localStat;
+            std::string localPath = localRoot + "/" + entry.path;
+            if (stat(localPath.c_str(), &localStat) == 0 && localStat.st_size == entry.size &&
+                localStat.st_mtim.tv_sec == entry.mtimeSec && localStat.st_mtim.tv_nsec == entry.mtimeNsec) {
+                skippedFiles++;
+                continue;
+            }
+            if (entry.size >= options.largeFileThreshold) {
+                largeFiles.push_back(&entry);
+            } else {
+                smallFiles.push_back(&entry);
+            }
+        }
+        progress.totalItems = entries.size() - skippedFiles;
+
+        std::cout << " 服务器列出 " << entries.size() << " 个文件/目录 (大文件 " << largeFiles.size()
+                  << " 个分块下载, 小文件 " << smallFiles.size() << " 个";
+        if (skippedFiles > 0) {
+            std::cout << ", 已下载 " << skippedFiles << " 个";
+        }
+        std::cout << ")" << std::endl;
+
+        // 按路径排序后父目录总在子目录之前
+        std::sort(directories.begin(), directories.end(),
+                  [](const ManifestEntry* a, const ManifestEntry* b) { return a->path < b->path; });
+        for (const ManifestEntry* entry : directories) {
+            std::string localPath = localRoot + "/" + entry->path;
+            if (mkdir(localPath.c_str(), 0755) == 0 || errno == EEXIST) {
+                progress.successCount++;
+            } else {
+                progress.failCount++;
+            }
+        }
+
+        std::vector<std::thread> streams;
+        std::atomic<size_t> nextFile{0};
+        int streamCount = std::max(1, std::min(options.directoryStreams, static_cast<int>(smallFiles.size())));
+        for (int i = 0; i < streamCount && !smallFiles.empty(); i++) {
+            streams.emplace_back([this, &remoteDir, &localRoot, &smallFiles, &nextFile, &progress, i]() {
+                Trace::nameThread("download-files-" + std::to_string(i));
+                // 每条流一条连接，连续请求多个文件；出错后重连，当前文件计为失败
+                int socket = -1;
+                size_t k;
+                while ((k = nextFile++) < smallFiles.size()) {
+                    const ManifestEntry& entry = *smallFiles[k];
+                    try {
+                        if (socket < 0) {
+                            socket = acquireConnection();
+                        }
+                        if (downloadDirectoryFile(socket, remoteDir + "/" + entry.path, localRoot + "/" + entry.path,
+                                                  remoteInfoFromEntry(entry))) {
+                            progress.successCount++;
+                        } else {
+                            progress.failCount++;
+                        }
+                    } catch (const std::exception&) {
+                        if (socket >= 0) {
+                            close(socket);
+                            socket = -1;
+                        }
+                        progress.failCount++;
+                    }
+                    reportDirectoryProgress(progress);
+                }
+                releaseConnection(socket);
+            });
+        }
+
+        // 大文件与小文件流并发，按多线程模式分块下载
+        for (const ManifestEntry* entry : largeFiles) {
+            try {
+                TransferStats stats;
+                stats.startTime = std::chrono::steady_clock::now();
+                stats.fileSize = entry->size;
+                downloadChunked(remoteDir + "/" + entry->path, localRoot + "/" + entry->path,
+                                remoteInfoFromEntry(*entry), options.directoryStreams, stats, false);
+                progress.successCount++;
+            } catch (const std::exception& e) {
+                progress.failCount++;
+                Logger::error("\n 大文件下载失败: " + entry->path + ": " + e.what());
+            }
+            reportDirectoryProgress(progress);
+        }
+
+        for (auto& stream : streams) {
+            stream.join();
+        }
+        reportDirectoryProgress(progress, true);
+        Logger::flush();
+
+        // 写入文件会改变目录的修改时间，目录属性最后恢复，子目录先于父目录
+        for (auto it = directories.rbegin(); it != directories.rend(); ++it) {
+            NetworkUtils::applyFileAttributes(localRoot + "/" + (*it)->path, remoteInfoFromEntry(**it).attrs);
+        }
+
+        int successCount = progress.successCount;
+        int failCount = progress.failCount;
+        std::cout << std::endl;
+
+        auto endTime = std::chrono::steady_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+
+        double filesPerSecond = (duration > 0) ? (double)successCount / duration * 1000 : 0;
+
+        std::cout << "  传输耗时: " << duration << " ms" << std::endl;
+        std::cout << " 统计: 成功 " << successCount << " 个, 失败 " << failCount << " 个" << std::endl;
+        std::cout << " 文件速率: " << std::fixed << std::setprecision(1) << filesPerSecond << " 个/秒" << std::endl;
+
+    } catch (const std::exception& e) {
+        Logger::flush();
+        std::cerr << "\n 文件夹下载错误: " << e.what() << std::endl;
+        throw;
+    }
+}
+
+// 小文件整个作为一个范围请求，写入临时文件后改名；协议出错时抛出，由调用方重建连接
+bool TransferHandlers::downloadDirectoryFile(int socket, const std::string& remotePath, const std::string& localPath,
+                                             const RemoteFileInfo& remote) {
+    std::string partPath = localPath + ".part";
+    int fd = open(partPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    TransferStats stats;
+    try {
+        receiveRange(socket, fd, remotePath, remote, 0, remote.fileSize, stats);
+    } catch (...) {
+        close(fd);
+        unlink(partPath.c_str());
+        throw;
+    }
+    close(fd);
+
+    if (rename(partPath.c_str(), localPath.c_str()) != 0) {
+        unlink(partPath.c_str());
+        return false;
+    }
+    NetworkUtils::applyFileAttributes(localPath, remote.attrs);
+    return true;
+}
+
+void TransferHandlers::recordPipelineWait(const ReadAheadPipeline& pipeline) {
+    pipelineDiskWaitNanos += pipeline.diskWaitNanos();
+    pipelineNetworkWaitNanos += pipeline.networkWaitNanos();
+}
+
+uint32_t TransferHandlers::updateChecksum(uint32_t crc, const char* data, size_t length) {
+    auto start = std::chrono::steady_clock::now();
+    crc = Checksum::crc32c(crc, data, length);
+    checksumNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    checksumBytes += length;
+    return crc;
+}
+
+void TransferHandlers::reportEngineStats(long long bytes, double cpuSecondsStart) {
+    double cpuSeconds = NetworkUtils::processCpuSeconds() - cpuSecondsStart;
+    double gigabytes = (double)bytes / (1024.0 * 1024 * 1024);
+
+    if (options.sendEngine == SendEngine::ZeroCopy && !usesZeroCopy()) {
+        std::cout << " 发送引擎: 缓冲 (pread+send)，v2 校验和需要数据经过用户态，不使用 sendfile" << std::endl;
+    } else if (options.sendEngine == SendEngine::ZeroCopy) {
+        std::cout << " 发送引擎: sendfile 零拷贝";
+        if (zeroCopyFallback) {
+            std::cout << " (不支持，已回退为 pread+send)";
+        }
+        std::cout << std::endl;
+    } else {
+        std::cout << " 发送引擎: 缓冲 (pread+send)" << std::endl;
+    }
+
+    std::cout << " CPU 时间: " << std::fixed << std::setprecision(0) << cpuSeconds * 1000 << " ms";
+    if (gigabytes > 0) {
+        std::cout << " (" << std::setprecision(1) << cpuSeconds * 1000 / gigabytes << " ms/GB)";
+    }
+    std::cout << std::endl;
+
+    BufferPool::Stats pool = BufferPool::stats();
+    if (pool.acquires > 0) {
+        std::cout << " 缓冲池: 借用 " << pool.acquires << " 次, 新分配缓冲区 " << pool.allocations
+                  << " 次 (线程缓存命中 " << pool.threadCacheHits << ", 全局池命中 " << pool.globalHits << ")"
+                  << std::endl;
+    }
+
+    ConnectionPool::Stats connections = ConnectionPool::stats();
+    if (connections.reuses > 0) {
+        std::cout << " 连接池: 请求 " << connections.acquires << " 次, 新建连接 " << connections.connects
+                  << " 次, 复用 " << connections.reuses << " 次" << std::endl;
+    }
+
+    long long diskWait = pipelineDiskWaitNanos.exchange(0);
+    long long networkWait = pipelineNetworkWaitNanos.exchange(0);
+    if (diskWait > 0 || networkWait > 0) {
+        // 发送方等磁盘多说明瓶颈在磁盘，读线程等发送方多说明瓶颈在网络
+        std::cout << " 预读流水线: 等待磁盘 " << diskWait / 1000000 << " ms, 等待网络 "
+                  << networkWait / 1000000 << " ms" << std::endl;
+    }
+
+    long long measuredChunks = hotPathChunks.exchange(0);
+    long long allocations = hotPathAllocations.exchange(0);
+    if (AllocationCounter::enabled() && measuredChunks > 0) {
+        std::cout << " 热路径堆分配: 预热后 " << measuredChunks << " 块共 " << allocations << " 次" << std::endl;
+    }
+
+    long long hashedBytes = checksumBytes.exchange(0);
+    long long hashNanos = checksumNanos.exchange(0);
+    if (hashedBytes > 0) {
+        double hashSpeed = hashNanos > 0 ? (double)hashedBytes / hashNanos * 1e9 / (1024 * 1024) : 0;
+        std::cout << " 校验和: CRC32C (" << (Checksum::hardwareCrc32c() ? "SSE4.2" : "软件查表") << "), "
+                  << std::setprecision(0) << hashSpeed << " MB/s, 耗时 " << hashNanos / 1000000 << " ms"
+                  << std::endl;
+    }
+}
+
+void TransferHandlers::reportChunkLatency(const std::vector<double>& chunkLatencyMs) {
+    if (chunkLatencyMs.empty()) {
+        return;
+    }
+
+    std::vector<double> sorted = chunkLatencyMs;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double p) {
+        size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+        return sorted[index];
+    };
+
+    int slowest = std::max_element(chunkLatencyMs.begin(), chunkLatencyMs.end()) - chunkLatencyMs.begin();
+
+    std::cout << " 块耗时: p50 " << std::fixed << std::setprecision(1) << percentile(0.50)
+              << " ms, p90 " << percentile(0.90)
+              << " ms, p99 " << percentile(0.99)
+              << " ms, 最大 " << sorted.back() << " ms (块 " << slowest << ")" << std::endl;
+}
+
+void TransferHandlers::reportCompressionStats(long long durationMs) {
+    long long rawBytes = compressionStats.rawBytes;
+    long long wireBytes = compressionStats.wireBytes;
+    if (rawBytes == 0 || wireBytes == 0) {
+        return;
+    }
+
+    double seconds = durationMs > 0 ? durationMs / 1000.0 : 0;
+    double ratio = (double)rawBytes / wireBytes;
+    std::cout << " 压缩: " << (options.compression == CompressionMode::High ? "LZ4 高压缩比" : "LZ4 快速")
+              << ", " << std::fixed << std::setprecision(2) << rawBytes / (1024.0 * 1024) << " MB -> "
+              << wireBytes / (1024.0 * 1024) << " MB (" << ratio << "x), 压缩块 "
+              << compressionStats.compressedBlocks << ", 跳过块 " << compressionStats.storedBlocks
+              << ", 压缩耗时 " << compressionStats.nanos / 1000000 << " ms" << std::endl;
+    if (seconds > 0) {
+        std::cout << " 有效吞吐: " << std::setprecision(2) << rawBytes / seconds / (1024 * 1024)
+                  << " MB/s (线上 " << wireBytes / seconds / (1024 * 1024) << " MB/s)" << std::endl;
+    }
+}
+
+void TransferHandlers::reportDedupStats() {
+    long long queried = dedupQueried.exchange(0);
+    long long hits = dedupHits.exchange(0);
+    long long saved = dedupBytesSaved.exchange(0);
+    if (queried == 0) {
+        return;
+    }
+
+    std::cout << " 去重: 命中 " << hits << "/" << queried << " 个块 (" << std::fixed << std::setprecision(1)
+              << (double)hits / queried * 100 << "%), 节省 " << std::setprecision(2)
+              << saved / (1024.0 * 1024) << " MB" << std::endl;
+}
+
+void TransferHandlers::negotiateProtocol() {
+    if (protocolVersion != 0) {
+        return;
+    }
+
+    TraceSpan negotiateSpan("connection", "negotiate");
+    protocolVersion = NetworkUtils::negotiateProtocol(serverIP, serverPort, serverCapabilities);
+    negotiateSpan.end();
+    if (protocolVersion >= 2) {
+        std::cout << " 协议版本: v" << protocolVersion << std::endl;
+    } else {
+        std::cout << " 服务器不支持协议 v2，使用 v1" << std::endl;
+        if (options.compression != CompressionMode::None) {
+            std::cout << " v1 服务器不支持压缩，按原始数据发送" << std::endl;
+        }
+    }
+}
+
+// 自动调节时按文件大小选块大小，保证每条流都能分到几个块，流数变化时才有块可以重新分配。
+// 服务器会话建立时就固定了分块，传输中途不能再改块大小
+long long TransferHandlers::transferChunkSize(long long fileSize) const {
+    if (!options.autoTuneStreams) {
+        return std::max(1LL, options.chunkSize);
+    }
+    const long long megabyte = 1024 * 1024;
+    long long chunkSize = fileSize / (MAX_THREADS * AUTO_CHUNKS_PER_STREAM);
+    chunkSize = (chunkSize + megabyte - 1) / megabyte * megabyte;
+    return std::max(megabyte, std::min(DEFAULT_CHUNK_SIZE, chunkSize));
+}
+
+void TransferHandlers::reportTuning(const StreamTuner& tuner, bool showProgress) {
+    if (showProgress) {
+        std::cout << "\n 自动调节: 最终 " << tuner.streams() << " 条流 (峰值 " << tuner.peakStreams() << "), 决策 "
+                  << tuner.decisions() << " 次, 记录见 " << options.tuningLogPath << std::endl;
+    }
+}
+
+int TransferHandlers::acquireConnection() {
+    return ConnectionPool::acquire(serverIP, serverPort);
+}
+
+void TransferHandlers::releaseConnection(int socket) {
+    ConnectionPool::release(socket, serverIP, serverPort, keepAlive());
+}
+
+// 复用的空闲连接在取出时已检查过对端是否关闭，失效的连接在写出请求之前就换成新连接。
+// 请求一旦写出便不再重发: 服务器可能已经处理了它 (例如已建立会话并预分配文件)
+bool TransferHandlers::controlRequest(const std::function<bool(int socket)>& exchange) {
+    int socket = acquireConnection();
+    bool ok = false;
+    try {
+        ok = exchange(socket);
+    } catch (...) {
+        close(socket);
+        throw;
+    }
+    if (ok) {
+        releaseConnection(socket);
+    } else {
+        close(socket);
+    }
+    return ok;
+}
+
+bool TransferHandlers::keepAlive() const {
+    return protocolVersion >= 2 && (serverCapabilities & CAPABILITY_KEEPALIVE);
+}
+
+// v1 协议不传校验和，此时不计算，零拷贝发送不必为此把数据读进用户态
+bool TransferHandlers::sendsChecksums() const {
+    return protocolVersion >= 2 && options.verifyChecksums;
+}
+
+// 校验和要读入数据，此时改走预读管道，校验后从同一缓冲区发送，不为 sendfile 再读一遍
+bool TransferHandlers::usesZeroCopy() const {
+    return options.sendEngine == SendEngine::ZeroCopy && !sendsChecksums();
+}
+
+bool TransferHandlers::sendDirectoryEntryHeader(int socket, char itemType, const std::string& relativePath,
+                                                const FileAttributes& attrs, long long fileSize) {
+    if (protocolVersion >= 2) {
+        WireMessage header(FrameType::DirectoryEntry);
+        header.put(static_cast<uint8_t>(itemType));
+        header.putString(relativePath);
+        header.putAttributes(attrs);
+        if (itemType == 'F' || itemType == 'Z' || itemType == 'S') {
+            header.put(static_cast<uint64_t>(fileSize));
+        }
+        return header.sendAll(socket);
+    }
+
+    WireMessage header;
+    header.putNative(itemType);
+    header.putNative(static_cast<int>(relativePath.size()));
+    header.putBytes(relativePath.data(), relativePath.size());
+    header.putNative(attrs);
+    if (itemType == 'F') {
+        header.putNative(fileSize);
+    }
+    return header.sendAll(socket);
 }
\ No newline at end of file
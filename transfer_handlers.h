@@ -3,7 +3,77 @@
 
 #include <string>
 #include "../common/transfer_stats.h"
+#include "../common/file_attributes.h"
+#include "compression.h"
+#include "logger.h"
 #include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+class ReadAheadPipeline;
+class ResumeJournal;
+class ScanQueue;
+class CreatedDirectories;
+class StreamTuner;
+class MetricsReporter;
+class TraceRecorder;
+struct ScanEntry;
+
+enum class SendEngine {
+    Buffered,   // 预读线程 pread() 进池化缓冲区，发送线程 send()
+    ZeroCopy    // sendfile() 直接由页缓存发送，失败时回退到 pread()+send()；v2 发送校验和时也改走 pread()+send()
+};
+
+enum class SyncMode {
+    Full,           // 传输全部内容
+    Incremental,    // 先交换目录清单，只传输新增和变化的项
+    Mirror          // 增量同步，并删除服务器上本地已不存在的项
+};
+
+// 顺序传输发现服务器上有断点时的处理方式
+enum class ResumePolicy {
+    Ask,        // 交互模式: 询问用户
+    Resume,     // 从断点继续
+    Restart,    // 重置断点，从头传输
+    Refuse      // 命令行模式未指定时不读标准输入，直接报错
+};
+
+const long long DEFAULT_CHUNK_SIZE = 16 * 1024 * 1024;
+const long long DEFAULT_LARGE_FILE_THRESHOLD = 64 * 1024 * 1024;
+const size_t DIRECTORY_ROUND_ITEMS = 4096;                        // 文件夹流每轮 (每条连接) 最多发送的项数
+
+struct TransferOptions {
+    SendEngine sendEngine = SendEngine::Buffered;
+    long long chunkSize = DEFAULT_CHUNK_SIZE;
+    int directoryStreams = 4;                                   // 文件夹模式并行流数量
+    int scanThreads = 4;                                        // 文件夹扫描线程数
+    long long largeFileThreshold = DEFAULT_LARGE_FILE_THRESHOLD; // 达到此大小的文件按块传输
+    bool packSmallFiles = true;                                 // 小文件合并为批记录发送
+    long long packFileThreshold = 256 * 1024;
+    size_t packBatchSize = 4 * 1024 * 1024;
+    bool verifyChecksums = true;                                // v2 下随数据计算 CRC32C，由服务器校验
+    CompressionMode compression = CompressionMode::None;        // 仅 v2，多线程和文件夹模式
+    bool deduplicate = true;                                    // 服务器支持时先按块摘要去重
+    bool sparseFiles = true;                                    // 仅 v2，稀疏文件只发送数据区
+    SyncMode syncMode = SyncMode::Full;                         // 仅 v2 且服务器支持时生效
+    bool manifestDigests = false;                               // 清单附带内容摘要，不只比较大小和修改时间
+    bool autoTuneStreams = false;                               // 分块传输时按实测吞吐自动增减并行流数
+    std::string tuningLogPath = "transfer_tuning.log";          // 自动调节的决策记录
+    std::string metricsPath;                                    // 非空时定期把传输指标追加写入该文件
+    int metricsIntervalMs = 1000;
+    std::string tracePath;                                      // 非空时记录各阶段时间线，结束后写成 Chrome trace JSON
+    ResumePolicy resumePolicy = ResumePolicy::Ask;
+};
+
+struct DirectoryProgress {
+    std::atomic<int> successCount{0};
+    std::atomic<int> failCount{0};
+    std::atomic<int> totalItems{0};             // 边扫描边增加
+    ProgressThrottle throttle;
+};
 
 struct ResumeInfo {
     long long fileSize;
@@ -12,25 +82,88 @@ struct ResumeInfo {
     std::string fileName;
 };
 
+struct RemoteFileInfo {
+    long long fileSize = 0;
+    FileAttributes attrs;
+};
+
 class TransferHandlers {
 private:
     std::string serverIP;
     int serverPort;
+    TransferOptions options;
+    std::atomic<bool> zeroCopyFallback{false};
+    int protocolVersion = 0;          // 0 表示尚未协商
+    uint32_t serverCapabilities = 0;
+    std::atomic<long long> checksumBytes{0};
+    std::atomic<long long> checksumNanos{0};
+    CompressionStats compressionStats;
+    std::atomic<long long> pipelineDiskWaitNanos{0};
+    std::atomic<long long> pipelineNetworkWaitNanos{0};
+    std::atomic<long long> hotPathAllocations{0};    // 仅在 COUNT_ALLOCATIONS 构建中非零
+    std::atomic<long long> hotPathChunks{0};
+    std::atomic<long long> dedupQueried{0};
+    std::atomic<long long> dedupHits{0};
+    std::atomic<long long> dedupBytesSaved{0};
+    std::unique_ptr<MetricsReporter> metrics;
+    std::unique_ptr<TraceRecorder> trace;
 
 public:
-    TransferHandlers(const std::string& ip, int port);
+    TransferHandlers(const std::string& ip, int port, const TransferOptions& opts = TransferOptions());
+    ~TransferHandlers();
     void sequentialTransfer(const std::string& filePath);
     void multithreadedTransfer(const std::string& filePath, int numThreads = 4);
     void directoryTransfer(const std::string& dirPath);
+    void deltaTransfer(const std::string& filePath);
+    void downloadFile(const std::string& remotePath, const std::string& localDir, int numThreads = 1);
+    void downloadDirectory(const std::string& remoteDir, const std::string& localDir);
 
 private:
+    void negotiateProtocol();
+    // 从连接池取连接；请求完整结束后归还，服务器不支持保持连接时归还即关闭
+    int acquireConnection();
+    void releaseConnection(int socket);
+    // 在一条连接上完成一次请求和回复，成功后归还连接；请求写出后失败不重发
+    bool controlRequest(const std::function<bool(int socket)>& exchange);
+    bool keepAlive() const;
+    bool sendsChecksums() const;
+    bool usesZeroCopy() const;
+    long long transferChunkSize(long long fileSize) const;
+    void reportTuning(const StreamTuner& tuner, bool showProgress);
     ResumeInfo checkResumeInfo(int socket, const std::string& fileName, long fileSize);
-    void sendChunk(int chunkIndex, int sessionId, long startPos, long chunkSize, 
-                  const std::string& filePath, TransferStats& stats);
-    void scanDirectory(const std::string& basePath, const std::string& relativePath, 
-                      std::vector<std::pair<std::string, bool>>& result);
+    void uploadChunked(const std::string& filePath, const std::string& remoteName,
+                       const FileAttributes& attrs, long fileSize, int numThreads,
+                       TransferStats& stats, std::vector<double>& chunkLatencyMs, bool showProgress);
+    int deduplicateChunks(const std::string& filePath, int sessionId, long fileSize, long chunkSize,
+                          int totalChunks, int workerCount, ResumeJournal& journal, TransferStats& stats);
+    uint32_t sendChunk(int chunkIndex, int sessionId, long startPos, long chunkSize, 
+                  const std::string& filePath, bool sparse, TransferStats& stats);
+    void syncManifest(const std::string& dirName, const std::string& dirPath,
+                      std::vector<ScanEntry>& entries, int& deletedCount);
+    bool sendDirectoryStream(const std::string& dirName, const std::string& dirPath, ScanQueue& queue,
+                             DirectoryProgress& progress, CreatedDirectories* createdDirectories);
+    bool sendDirectoryRound(const std::string& dirName, const std::string& dirPath,
+                            const std::vector<ScanEntry>& items, DirectoryProgress& progress);
+    void reportDirectoryProgress(DirectoryProgress& progress, bool final = false);
     bool sendDirectoryItem(int socket, const std::string& relativePath, const std::string& fullPath);
     bool sendDirectoryFile(int socket, const std::string& relativePath, const std::string& fullPath);
+    bool sendDirectoryEntryHeader(int socket, char itemType, const std::string& relativePath,
+                                  const FileAttributes& attrs, long long fileSize);
+    void requireDownloadSupport();
+    bool requestRemoteFile(int socket, const std::string& remotePath, long long offset, long long length,
+                           RemoteFileInfo& info, long long& dataLength);
+    void downloadChunked(const std::string& remotePath, const std::string& localPath, const RemoteFileInfo& remote,
+                         int numThreads, TransferStats& stats, bool showProgress);
+    uint32_t receiveRange(int socket, int fd, const std::string& remotePath, const RemoteFileInfo& remote,
+                          long long offset, long long length, TransferStats& stats);
+    bool downloadDirectoryFile(int socket, const std::string& remotePath, const std::string& localPath,
+                               const RemoteFileInfo& remote);
+    void recordPipelineWait(const ReadAheadPipeline& pipeline);
+    uint32_t updateChecksum(uint32_t crc, const char* data, size_t length);
+    void reportEngineStats(long long bytes, double cpuSecondsStart);
+    void reportChunkLatency(const std::vector<double>& chunkLatencyMs);
+    void reportCompressionStats(long long durationMs);
+    void reportDedupStats();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "wire_protocol.h"
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+WireMessage::WireMessage() : totalSize(0), framed(false) {
+    inlineData.reserve(256);
+}
+
+WireMessage::WireMessage(FrameType type) : WireMessage() {
+    putFrameHeader(type);
+}
+
+void WireMessage::reset() {
+    inlineData.clear();
+    segments.clear();
+    totalSize = 0;
+    framed = false;
+}
+
+void WireMessage::reset(FrameType type) {
+    reset();
+    putFrameHeader(type);
+}
+
+void WireMessage::putFrameHeader(FrameType type) {
+    framed = true;
+    put(PROTOCOL_MAGIC);
+    put(PROTOCOL_VERSION);
+    put(type);
+    put(static_cast<uint32_t>(0));  // 载荷长度，发送前回填
+}
+
+void WireMessage::appendInline(const void* data, size_t size) {
+    size_t offset = inlineData.size();
+    inlineData.insert(inlineData.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+
+    if (!segments.empty() && segments.back().external == nullptr &&
+        segments.back().offset + segments.back().length == offset) {
+        segments.back().length += size;
+    } else {
+        segments.push_back({nullptr, offset, size});
+    }
+    totalSize += size;
+}
+
+void WireMessage::putBytes(const void* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    segments.push_back({static_cast<const char*>(data), 0, size});
+    totalSize += size;
+}
+
+void WireMessage::putString(const std::string& value) {
+    put(static_cast<uint32_t>(value.size()));
+    putBytes(value.data(), value.size());
+}
+
+void WireMessage::putAttributes(const FileAttributes& attrs) {
+    put(static_cast<uint32_t>(attrs.permissions));
+    put(static_cast<int64_t>(attrs.access_time.tv_sec));
+    put(static_cast<int64_t>(attrs.access_time.tv_nsec));
+    put(static_cast<int64_t>(attrs.modify_time.tv_sec));
+    put(static_cast<int64_t>(attrs.modify_time.tv_nsec));
+    put(static_cast<uint32_t>(attrs.uid));
+    put(static_cast<uint32_t>(attrs.gid));
+}
+
+bool WireMessage::sendAll(int socket, size_t trailingBytes) {
+    if (framed) {
+        uint32_t payloadLength = static_cast<uint32_t>(totalSize - FRAME_HEADER_SIZE - trailingBytes);
+        for (size_t i = 0; i < sizeof(payloadLength); i++) {
+            inlineData[8 + i] = static_cast<char>(payloadLength >> (8 * i));
+        }
+    }
+
+    iov.resize(segments.size());
+    for (size_t i = 0; i < segments.size(); i++) {
+        const char* base = segments[i].external ? segments[i].external : inlineData.data() + segments[i].offset;
+        iov[i].iov_base = const_cast<char*>(base);
+        iov[i].iov_len = segments[i].length;
+    }
+
+    size_t index = 0;
+    while (index < iov.size()) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov[index];
+        msg.msg_iovlen = std::min(iov.size() - index, static_cast<size_t>(IOV_MAX));
+
+        // sendmsg 等价于套接字上的 writev，同时可以屏蔽 SIGPIPE
+        ssize_t result = sendmsg(socket, &msg, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+
+        size_t remaining = result;
+        while (index < iov.size() && remaining >= iov[index].iov_len) {
+            remaining -= iov[index].iov_len;
+            index++;
+        }
+        if (remaining > 0) {
+            iov[index].iov_base = static_cast<char*>(iov[index].iov_base) + remaining;
+            iov[index].iov_len -= remaining;
+        }
+    }
+
+    return true;
+}
+
+bool WireReader::recvFrame(int socket, FrameType expected, std::vector<char>& payload) {
+    std::vector<char> header(FRAME_HEADER_SIZE);
+    if (recv(socket, header.data(), header.size(), MSG_WAITALL) != static_cast<ssize_t>(header.size())) {
+        return false;
+    }
+
+    WireReader reader(header);
+    uint32_t magic = reader.get<uint32_t>();
+    uint16_t version = reader.get<uint16_t>();
+    uint16_t type = reader.get<uint16_t>();
+    uint32_t payloadLength = reader.get<uint32_t>();
+
+    if (magic != PROTOCOL_MAGIC || version != PROTOCOL_VERSION ||
+        type != static_cast<uint16_t>(expected) || payloadLength > MAX_FRAME_PAYLOAD) {
+        return false;
+    }
+
+    payload.resize(payloadLength);
+    if (payloadLength > 0 &&
+        recv(socket, payload.data(), payloadLength, MSG_WAITALL) != static_cast<ssize_t>(payloadLength)) {
+        return false;
+    }
+    return true;
+}
+
+std::string WireReader::getString() {
+    uint32_t length = get<uint32_t>();
+    if (failed || pos + length > data.size()) {
+        failed = true;
+        return std::string();
+    }
+    std::string value(data.data() + pos, length);
+    pos += length;
+    return value;
+}
+
+FileAttributes WireReader::getAttributes() {
+    FileAttributes attrs;
+    attrs.permissions = get<uint32_t>();
+    attrs.access_time.tv_sec = get<int64_t>();
+    attrs.access_time.tv_nsec = get<int64_t>();
+    attrs.modify_time.tv_sec = get<int64_t>();
+    attrs.modify_time.tv_nsec = get<int64_t>();
+    attrs.uid = get<uint32_t>();
+    attrs.gid = get<uint32_t>();
+    return attrs;
+}
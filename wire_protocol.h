@@ -0,0 +1,156 @@
+#ifndef WIRE_PROTOCOL_H
+#define WIRE_PROTOCOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include <sys/uio.h>
+#include "../common/file_attributes.h"
+
+// 协议 v2: 所有整数均为固定宽度小端序，每条消息以 12 字节帧头开始
+const uint32_t PROTOCOL_MAGIC = 0x32505446;   // 线上字节为 "FTP2"
+const uint16_t PROTOCOL_VERSION = 2;
+const size_t FRAME_HEADER_SIZE = 12;          // magic(4) + version(2) + type(2) + payloadLength(4)
+const uint32_t MAX_FRAME_PAYLOAD = 64 * 1024;
+
+// HelloAck 中的服务器能力位，需要服务器额外存储或状态的功能按位开启
+const uint32_t CAPABILITY_DEDUP = 1u << 0;    // 内容寻址的块去重索引
+const uint32_t CAPABILITY_MANIFEST = 1u << 1; // 按目录清单增量同步
+const uint32_t CAPABILITY_DOWNLOAD = 1u << 2; // 从服务器下载文件和文件夹
+const uint32_t CAPABILITY_KEEPALIVE = 1u << 3; // 请求完成后连接保持打开，继续处理后续帧
+
+enum class FrameType : uint16_t {
+    Hello = 1,
+    HelloAck = 2,
+    ResumeQuery = 3,
+    ResumeInfo = 4,
+    ResumeReset = 5,
+    Sequential = 6,
+    MultithreadControl = 7,
+    SessionCreated = 8,
+    Chunk = 9,
+    Directory = 10,
+    DirectoryEntry = 11,
+    FileBatch = 12,
+    DeltaRequest = 13,
+    DeltaSignatures = 14,
+    DeltaLiteral = 15,
+    DeltaCopy = 16,
+    DeltaEnd = 17,
+    ChunkChecksum = 18,
+    FileChecksum = 19,
+    CompressedChunk = 20,
+    CompressedFileBatch = 21,
+    DedupQuery = 22,
+    DedupResult = 23,
+    ExtentMap = 24,
+    SparseSequential = 25,
+    SparseChunk = 26,
+    ManifestBegin = 27,
+    ManifestEntries = 28,
+    ManifestNeeded = 29,
+    DownloadRequest = 30,
+    DownloadInfo = 31,
+    ListRequest = 32,
+    ListEntries = 33,
+    DeltaResult = 34
+};
+
+// 按字段构造一条消息，整条消息最终由一次 writev() 发出。
+// 标量被编码进内部缓冲区，putBytes() 只引用调用方内存而不拷贝。
+class WireMessage {
+public:
+    WireMessage();
+    explicit WireMessage(FrameType type);
+
+    WireMessage(const WireMessage&) = delete;
+    WireMessage& operator=(const WireMessage&) = delete;
+
+    // 清空内容以便复用，已分配的容量保留，热路径上每个线程复用同一个消息
+    void reset();
+    void reset(FrameType type);
+
+    template <typename T>
+    void put(T value) {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                      "WireMessage::put 只接受整数或枚举类型");
+        static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
+                      "WireMessage::put 只接受 1/2/4/8 字节类型");
+        using U = typename std::make_unsigned<typename std::conditional<std::is_enum<T>::value,
+            std::underlying_type<T>, std::common_type<T>>::type::type>::type;
+        U raw = static_cast<U>(value);
+        unsigned char bytes[sizeof(T)];
+        for (size_t i = 0; i < sizeof(T); i++) {
+            bytes[i] = static_cast<unsigned char>(raw >> (8 * i));
+        }
+        appendInline(bytes, sizeof(T));
+    }
+
+    // v1 兼容: 按本机内存布局原样发送，仅用于旧协议的字段批量发送
+    template <typename T>
+    void putNative(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "putNative 只接受可平凡拷贝的类型");
+        appendInline(&value, sizeof(T));
+    }
+
+    void putBytes(const void* data, size_t size);
+    void putString(const std::string& value);
+    void putAttributes(const FileAttributes& attrs);
+
+    size_t size() const { return totalSize; }
+    // trailingBytes: 末尾紧随帧载荷之后的原始数据长度，不计入帧头中的载荷长度
+    bool sendAll(int socket, size_t trailingBytes = 0);
+
+private:
+    struct Segment {
+        const char* external;   // 为空时表示位于 inlineData 中
+        size_t offset;
+        size_t length;
+    };
+
+    void appendInline(const void* data, size_t size);
+    void putFrameHeader(FrameType type);
+
+    std::vector<char> inlineData;
+    std::vector<Segment> segments;
+    std::vector<struct iovec> iov;
+    size_t totalSize;
+    bool framed;
+};
+
+// 解析收到的 v2 帧载荷
+class WireReader {
+public:
+    static bool recvFrame(int socket, FrameType expected, std::vector<char>& payload);
+
+    explicit WireReader(const std::vector<char>& payload) : data(payload), pos(0), failed(false) {}
+
+    template <typename T>
+    T get() {
+        static_assert(std::is_integral<T>::value, "WireReader::get 只接受整数类型");
+        using U = typename std::make_unsigned<T>::type;
+        if (pos + sizeof(T) > data.size()) {
+            failed = true;
+            return T();
+        }
+        U raw = 0;
+        for (size_t i = 0; i < sizeof(T); i++) {
+            raw |= static_cast<U>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+        }
+        pos += sizeof(T);
+        return static_cast<T>(raw);
+    }
+
+    std::string getString();
+    FileAttributes getAttributes();
+    bool ok() const { return !failed; }
+
+private:
+    const std::vector<char>& data;
+    size_t pos;
+    bool failed;
+};
+
+#endif